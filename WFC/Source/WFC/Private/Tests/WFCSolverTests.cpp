@@ -0,0 +1,351 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+#include "WaveFunctionCollapseComponent.h"
+#include "WFCSolver.h"
+#include "WFCRules.h"
+#include "Algo/Find.h"
+#include "HAL/PlatformTime.h"
+#include "UObject/Package.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace WFCTests
+{
+    // Slowest solve allowed for a square grid of the road tile set. The budgets leave headroom for
+    // Development editor builds on shared build machines; they catch regressions, not small slowdowns.
+    struct FSolveBudget
+    {
+        int32 GridSize;
+        double BudgetMs;
+    };
+
+    static const FSolveBudget SolveBudgets[] = { { 16, 5.0 }, { 32, 20.0 }, { 64, 80.0 }, { 128, 400.0 } };
+
+    static const EWFCPropagator Propagators[] = { EWFCPropagator::Bitmask, EWFCPropagator::SupportCount };
+
+    const TCHAR* GetPropagatorName(EWFCPropagator Propagator)
+    {
+        return Propagator == EWFCPropagator::Bitmask ? TEXT("Bitmask") : TEXT("SupportCount");
+    }
+
+    FTileType MakeRoadTile(bool bNorth, bool bEast, bool bSouth, bool bWest)
+    {
+        FTileType Tile;
+        Tile.NorthEdge = bNorth ? ETileEdgeType::Type_B : ETileEdgeType::Type_A;
+        Tile.EastEdge = bEast ? ETileEdgeType::Type_B : ETileEdgeType::Type_A;
+        Tile.SouthEdge = bSouth ? ETileEdgeType::Type_B : ETileEdgeType::Type_A;
+        Tile.WestEdge = bWest ? ETileEdgeType::Type_B : ETileEdgeType::Type_A;
+        Tile.bGenerateRotations = true;
+        return Tile;
+    }
+
+    // Component without a world, so generating solves the grid without spawning anything.
+    // Grass (A) and road (B) edges with every road shape turned four ways, so every grid can be solved.
+    UWaveFunctionCollapseComponent* MakeRoadComponent()
+    {
+        UWaveFunctionCollapseComponent* Component = NewObject<UWaveFunctionCollapseComponent>(GetTransientPackage());
+        Component->AddToRoot();
+        Component->bGenerateOnBeginPlay = false;
+        Component->TileTypes =
+        {
+            MakeRoadTile(false, false, false, false),
+            MakeRoadTile(true, false, false, false),
+            MakeRoadTile(true, false, true, false),
+            MakeRoadTile(true, true, false, false),
+            MakeRoadTile(true, true, true, false),
+            MakeRoadTile(true, true, true, true)
+        };
+        Component->TileTypes[0].Weight = 4.f;
+        return Component;
+    }
+
+    void DestroyComponent(UWaveFunctionCollapseComponent*& Component)
+    {
+        if (Component)
+        {
+            Component->RemoveFromRoot();
+            Component->MarkAsGarbage();
+            Component = nullptr;
+        }
+    }
+
+    // Compiled tile index of every cell of the last generated grid, read back through GetCell; -1 where a cell has no tile
+    TArray<int32> GetStates(const UWaveFunctionCollapseComponent& Component)
+    {
+        TArray<int32> States;
+        const TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> Rules = Component.GetCompiledRules();
+        if (!Rules)
+            return States;
+
+        for (int32 Z = 0; Z < Component.GridDepth; ++Z)
+        {
+            for (int32 Y = 0; Y < Component.GridHeight; ++Y)
+            {
+                for (int32 X = 0; X < Component.GridWidth; ++X)
+                {
+                    const FCell Cell = Component.GetCell(X, Y, Z);
+                    int32 State = -1;
+                    for (int32 Tile = 0; Cell.bIsCollapsed && Tile < Rules->GetNumTiles(); ++Tile)
+                    {
+                        const FWFCTileVariant& Variant = Rules->GetVariant(Tile);
+                        if (Variant.SourceTile == Cell.FinalState && Variant.Rotation == Cell.Rotation && Variant.bReflected == Cell.bReflected)
+                        {
+                            State = Tile;
+                            break;
+                        }
+                    }
+                    States.Add(State);
+                }
+            }
+        }
+        return States;
+    }
+
+    // Edge a tile type shows on a side once turned, worked out from the authored edges rather than the compiled variants
+    ETileEdgeType GetTurnedEdge(const FTileType& Tile, int32 Rotation, EWFCDirection Direction)
+    {
+        const ETileEdgeType Edges[] = { Tile.NorthEdge, Tile.EastEdge, Tile.SouthEdge, Tile.WestEdge, Tile.UpEdge, Tile.DownEdge };
+        int32 Dir = static_cast<int32>(Direction);
+        if (Dir < FWFCCompiledRules::NumHorizontalDirections)
+        {
+            // Each quarter turn moves an edge one side clockwise
+            Dir = ((Dir - Rotation) % 4 + 4) % 4;
+        }
+        return Edges[Dir];
+    }
+}
+
+BEGIN_DEFINE_SPEC(FWFCSolverCorrectnessSpec, "WFC.Solver.Correctness", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+    UWaveFunctionCollapseComponent* Component = nullptr;
+
+    // Check the grid of the last generation is complete and every pair of adjacent tiles fits
+    void TestGrid(const FString& What);
+END_DEFINE_SPEC(FWFCSolverCorrectnessSpec)
+
+void FWFCSolverCorrectnessSpec::Define()
+{
+    BeforeEach([this]()
+    {
+        Component = WFCTests::MakeRoadComponent();
+    });
+
+    AfterEach([this]()
+    {
+        WFCTests::DestroyComponent(Component);
+    });
+
+    for (EWFCPropagator Propagator : WFCTests::Propagators)
+    {
+        Describe(WFCTests::GetPropagatorName(Propagator), [this, Propagator]()
+        {
+            It("fills a flat grid with matching edges", [this, Propagator]()
+            {
+                Component->Propagator = Propagator;
+                Component->GridWidth = 24;
+                Component->GridHeight = 24;
+
+                for (int32 GridSeed = 0; GridSeed < 8; ++GridSeed)
+                {
+                    Component->Seed = GridSeed;
+                    Component->GenerateGrid();
+                    TestGrid(FString::Printf(TEXT("Seed %d"), GridSeed));
+                }
+            });
+
+            It("fills a layered grid with matching edges", [this, Propagator]()
+            {
+                Component->Propagator = Propagator;
+                Component->GridWidth = 12;
+                Component->GridHeight = 12;
+                Component->GridDepth = 3;
+
+                for (int32 GridSeed = 0; GridSeed < 4; ++GridSeed)
+                {
+                    Component->Seed = GridSeed;
+                    Component->GenerateGrid();
+                    TestGrid(FString::Printf(TEXT("Seed %d"), GridSeed));
+                }
+            });
+
+            It("fills the seams of regions solved in parallel", [this, Propagator]()
+            {
+                Component->Propagator = Propagator;
+                Component->GridWidth = 40;
+                Component->GridHeight = 40;
+                Component->bSolveRegionsInParallel = true;
+                Component->ParallelRegionSize = 16;
+
+                for (int32 GridSeed = 0; GridSeed < 4; ++GridSeed)
+                {
+                    Component->Seed = GridSeed;
+                    Component->GenerateGrid();
+                    TestGrid(FString::Printf(TEXT("Seed %d"), GridSeed));
+                }
+            });
+        });
+    }
+}
+
+void FWFCSolverCorrectnessSpec::TestGrid(const FString& What)
+{
+    const TArray<int32> States = WFCTests::GetStates(*Component);
+    if (!TestEqual(What + TEXT(": cells"), States.Num(), Component->GridWidth * Component->GridHeight * Component->GridDepth))
+        return;
+
+    const int32 EmptyCell = States.Find(-1);
+    if (!TestEqual(What + TEXT(": first cell without a tile"), EmptyCell, INDEX_NONE))
+        return;
+
+    TestEqual(What + TEXT(": first cell breaking the compiled rules"),
+        FWFCSolver::FindInvalidCell(*Component->GetCompiledRules(), Component->GridWidth, Component->GridHeight, States, Component->GridDepth), INDEX_NONE);
+
+    // Each pair is checked once, from its west, north or lower cell, with both edges facing each other
+    static const EWFCDirection Forward[] = { EWFCDirection::East, EWFCDirection::South, EWFCDirection::Up };
+
+    for (int32 Z = 0; Z < Component->GridDepth; ++Z)
+    {
+        for (int32 Y = 0; Y < Component->GridHeight; ++Y)
+        {
+            for (int32 X = 0; X < Component->GridWidth; ++X)
+            {
+                const FCell Cell = Component->GetCell(X, Y, Z);
+
+                for (EWFCDirection Direction : Forward)
+                {
+                    const FIntVector Neighbor = FIntVector(X, Y, Z) + FWFCCompiledRules::GetOffset(Direction);
+                    if (Neighbor.X >= Component->GridWidth || Neighbor.Y >= Component->GridHeight || Neighbor.Z >= Component->GridDepth)
+                        continue;
+
+                    const FCell NeighborCell = Component->GetCell(Neighbor.X, Neighbor.Y, Neighbor.Z);
+                    const ETileEdgeType Edge = WFCTests::GetTurnedEdge(Component->TileTypes[Cell.FinalState], Cell.Rotation, Direction);
+                    const ETileEdgeType NeighborEdge = WFCTests::GetTurnedEdge(Component->TileTypes[NeighborCell.FinalState], NeighborCell.Rotation, FWFCCompiledRules::GetOppositeDirection(Direction));
+
+                    if (!Component->AreEdgesCompatible(Edge, NeighborEdge) || !Component->AreEdgesCompatible(NeighborEdge, Edge))
+                    {
+                        AddError(FString::Printf(TEXT("%s: cell (%d, %d, %d) doesn't match its neighbor (%d, %d, %d)"), *What, X, Y, Z, Neighbor.X, Neighbor.Y, Neighbor.Z));
+                        return;
+                    }
+                }
+            }
+        }
+    }
+
+    TestTrue(What + TEXT(": VerifyGrid"), Component->VerifyGrid());
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FWFCSolverDeterminismTest, "WFC.Solver.Determinism", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FWFCSolverDeterminismTest::RunTest(const FString& Parameters)
+{
+    UWaveFunctionCollapseComponent* Component = WFCTests::MakeRoadComponent();
+    Component->GridWidth = 40;
+    Component->GridHeight = 40;
+
+    static const int32 RegionSizes[] = { 0, 16 };
+    static const int32 Seeds[] = { 1, 7, 1234 };
+
+    for (EWFCPropagator Propagator : WFCTests::Propagators)
+    {
+        for (int32 RegionSize : RegionSizes)
+        {
+            Component->Propagator = Propagator;
+            Component->bSolveRegionsInParallel = RegionSize > 0;
+            Component->ParallelRegionSize = FMath::Max(RegionSize, 16);
+
+            for (int32 GridSeed : Seeds)
+            {
+                const FString What = FString::Printf(TEXT("%s, region size %d, seed %d"), WFCTests::GetPropagatorName(Propagator), RegionSize, GridSeed);
+                Component->Seed = GridSeed;
+
+                Component->GenerateGrid();
+                const TArray<int32> First = WFCTests::GetStates(*Component);
+                Component->GenerateGrid();
+                const TArray<int32> Second = WFCTests::GetStates(*Component);
+
+                TestFalse(What + TEXT(": grid has empty cells"), First.Contains(-1));
+                TestTrue(What + TEXT(": same grid when generated again"), First == Second);
+                TestTrue(What + TEXT(": VerifyDeterminism"), Component->VerifyDeterminism());
+            }
+        }
+    }
+
+    WFCTests::DestroyComponent(Component);
+    return true;
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FWFCSolverBudgetTest, "WFC.Solver.Performance", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+void FWFCSolverBudgetTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+    for (const WFCTests::FSolveBudget& Budget : WFCTests::SolveBudgets)
+    {
+        OutBeautifiedNames.Add(FString::Printf(TEXT("%dx%d"), Budget.GridSize, Budget.GridSize));
+        OutTestCommands.Add(FString::FromInt(Budget.GridSize));
+    }
+}
+
+bool FWFCSolverBudgetTest::RunTest(const FString& Parameters)
+{
+    const int32 GridSize = FCString::Atoi(*Parameters);
+    const WFCTests::FSolveBudget* Budget = Algo::FindBy(WFCTests::SolveBudgets, GridSize, &WFCTests::FSolveBudget::GridSize);
+    if (!Budget)
+    {
+        AddError(FString::Printf(TEXT("No solve budget for grid size %s"), *Parameters));
+        return false;
+    }
+
+    UWaveFunctionCollapseComponent* Component = WFCTests::MakeRoadComponent();
+    Component->GridWidth = GridSize;
+    Component->GridHeight = GridSize;
+    const bool bCompiled = Component->CompileRules();
+    TestTrue(TEXT("Rules compile"), bCompiled);
+
+    static const int32 NumSeeds = 10;
+
+    for (EWFCPropagator Propagator : WFCTests::Propagators)
+    {
+        if (!bCompiled)
+            break;
+
+        FWFCSolverSettings Settings;
+        Settings.Width = GridSize;
+        Settings.Height = GridSize;
+        Settings.Propagator = Propagator;
+        Settings.BacktrackDepth = Component->BacktrackDepth;
+        Settings.MaxBacktracks = Component->MaxBacktracks;
+        Settings.LocalRestartRadius = Component->LocalRestartRadius;
+        Settings.MaxLocalRestarts = Component->MaxLocalRestarts;
+
+        // Reused like a component reuses its solver; the first solve only allocates the buffers and isn't timed
+        FWFCSolver Solver;
+        Solver.Init(Component->GetCompiledRules().ToSharedRef(), Settings);
+        Solver.Run();
+
+        double SlowestMs = 0.0;
+        for (int32 GridSeed = 0; GridSeed < NumSeeds; ++GridSeed)
+        {
+            Settings.Seed = GridSeed;
+
+            const uint64 StartCycles = FPlatformTime::Cycles64();
+            Solver.Init(Component->GetCompiledRules().ToSharedRef(), Settings);
+            const EWFCSolveStatus Status = Solver.Run();
+            const double Milliseconds = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+
+            TestTrue(FString::Printf(TEXT("%s, seed %d: completed"), WFCTests::GetPropagatorName(Propagator), GridSeed), Status == EWFCSolveStatus::Completed);
+            SlowestMs = FMath::Max(SlowestMs, Milliseconds);
+        }
+
+        AddInfo(FString::Printf(TEXT("%s %dx%d: slowest of %d solves %.3f ms, budget %.3f ms"), WFCTests::GetPropagatorName(Propagator), GridSize, GridSize, NumSeeds, SlowestMs, Budget->BudgetMs));
+        if (SlowestMs > Budget->BudgetMs)
+        {
+            AddError(FString::Printf(TEXT("%s %dx%d: slowest solve %.3f ms is over the %.3f ms budget"), WFCTests::GetPropagatorName(Propagator), GridSize, GridSize, SlowestMs, Budget->BudgetMs));
+        }
+    }
+
+    WFCTests::DestroyComponent(Component);
+    return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,295 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCBenchmarkCommandlet.h"
+#include "WaveFunctionCollapseComponent.h"
+#include "WFCSolver.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+    // Timings and counters of every solve of one grid size and tile count
+    struct FBenchmarkResult
+    {
+        int32 GridSize = 0;
+        int32 NumTiles = 0;
+        int32 NumSolves = 0;
+        double P50Ms = 0.0;
+        double P99Ms = 0.0;
+        double MeanMs = 0.0;
+        double PropagationsPerSecond = 0.0;
+
+        // Fraction of solves that ran into at least one contradiction, and that failed to resolve it
+        double ContradictionRate = 0.0;
+        double FailureRate = 0.0;
+
+        // Largest solver allocation seen, and the process peak after the last solve
+        uint64 SolverBytes = 0;
+        uint64 PeakUsedPhysical = 0;
+
+        // With -Verify, solves whose grid breaks the rules or differs when solved again
+        int32 NumInvalid = 0;
+        int32 NumNondeterministic = 0;
+    };
+
+    // Comma separated list of positive integers, or Defaults if the parameter is missing
+    TArray<int32> ParseIntList(const FString& Params, const TCHAR* Name, const TArray<int32>& Defaults)
+    {
+        FString Value;
+        if (!FParse::Value(*Params, Name, Value))
+            return Defaults;
+
+        TArray<FString> Items;
+        Value.ParseIntoArray(Items, TEXT(","));
+
+        TArray<int32> Result;
+        for (const FString& Item : Items)
+        {
+            const int32 Number = FCString::Atoi(*Item);
+            if (Number > 0)
+            {
+                Result.Add(Number);
+            }
+        }
+        return Result.Num() > 0 ? Result : Defaults;
+    }
+
+    // Tile set with random edges and weights, where each edge type only connects to itself
+    FWFCSolver::FRulesRef MakeSyntheticRules(int32 NumTiles, int32 Seed)
+    {
+        FRandomStream Random(Seed);
+        const int32 NumEdgeTypes = FWFCEdgeMatrix::NumEdgeTypes;
+
+        TArray<FTileType> TileTypes;
+        TileTypes.SetNum(NumTiles);
+        for (FTileType& Tile : TileTypes)
+        {
+            Tile.NorthEdge = static_cast<ETileEdgeType>(Random.RandHelper(NumEdgeTypes));
+            Tile.EastEdge = static_cast<ETileEdgeType>(Random.RandHelper(NumEdgeTypes));
+            Tile.SouthEdge = static_cast<ETileEdgeType>(Random.RandHelper(NumEdgeTypes));
+            Tile.WestEdge = static_cast<ETileEdgeType>(Random.RandHelper(NumEdgeTypes));
+            Tile.Weight = Random.FRandRange(0.5f, 2.f);
+        }
+
+        FWFCEdgeMatrix Edges;
+        for (int32 Edge = 0; Edge < NumEdgeTypes; ++Edge)
+        {
+            Edges.Allow(static_cast<ETileEdgeType>(Edge), static_cast<ETileEdgeType>(Edge));
+        }
+
+        TSharedRef<FWFCCompiledRules, ESPMode::ThreadSafe> Rules = MakeShared<FWFCCompiledRules, ESPMode::ThreadSafe>();
+        Rules->Compile(TileTypes, Edges);
+        return Rules;
+    }
+
+    // Nearest-rank percentile of sorted samples
+    double GetPercentile(const TArray<double>& Sorted, double Fraction)
+    {
+        const int32 Rank = FMath::CeilToInt(Fraction * Sorted.Num()) - 1;
+        return Sorted[FMath::Clamp(Rank, 0, Sorted.Num() - 1)];
+    }
+}
+
+UWFCBenchmarkCommandlet::UWFCBenchmarkCommandlet()
+{
+    IsClient = false;
+    IsEditor = false;
+    IsServer = false;
+    LogToConsole = true;
+
+    HelpDescription = TEXT("Measures the Wave Function Collapse solver over grid sizes, synthetic tile sets and seeds.");
+    HelpUsage = TEXT("-run=WFCBenchmark [-Sizes=16,32,64] [-Tiles=8,32,128] [-Seeds=10] [-Propagator=Bitmask|SupportCount] [-Output=BaseFilePath] [-Verify] [-BudgetMs=N]");
+
+    HelpParamNames.Add(TEXT("Sizes"));
+    HelpParamDescriptions.Add(TEXT("[Optional] Comma separated side lengths of the square grids to solve."));
+
+    HelpParamNames.Add(TEXT("Tiles"));
+    HelpParamDescriptions.Add(TEXT("[Optional] Comma separated sizes of the synthetic tile sets."));
+
+    HelpParamNames.Add(TEXT("Seeds"));
+    HelpParamDescriptions.Add(TEXT("[Optional] Number of seeds solved per grid size and tile set."));
+
+    HelpParamNames.Add(TEXT("Propagator"));
+    HelpParamDescriptions.Add(TEXT("[Optional] Bitmask or SupportCount."));
+
+    HelpParamNames.Add(TEXT("Output"));
+    HelpParamDescriptions.Add(TEXT("[Optional] Path of the report without extension; .csv and .json files are written."));
+
+    HelpParamNames.Add(TEXT("Verify"));
+    HelpParamDescriptions.Add(TEXT("[Optional] Check every completed grid against the rules and that solving it again gives the same grid."));
+
+    HelpParamNames.Add(TEXT("BudgetMs"));
+    HelpParamDescriptions.Add(TEXT("[Optional] Fail when the p99 solve time of any configuration exceeds this many milliseconds."));
+}
+
+int32 UWFCBenchmarkCommandlet::Main(const FString& Params)
+{
+    TArray<FString> Tokens;
+    TArray<FString> Switches;
+    TMap<FString, FString> ParamVals;
+    ParseCommandLine(*Params, Tokens, Switches, ParamVals);
+
+    if (Switches.Contains(TEXT("help")))
+    {
+        UE_LOG(LogTemp, Display, TEXT("%s"), *HelpDescription);
+        UE_LOG(LogTemp, Display, TEXT("Usage: %s"), *HelpUsage);
+        for (int32 i = 0; i < HelpParamNames.Num(); ++i)
+        {
+            UE_LOG(LogTemp, Display, TEXT("\t-%s: %s"), *HelpParamNames[i], *HelpParamDescriptions[i]);
+        }
+        return 0;
+    }
+
+    const TArray<int32> GridSizes = ParseIntList(Params, TEXT("Sizes="), { 16, 32, 64 });
+    const TArray<int32> TileCounts = ParseIntList(Params, TEXT("Tiles="), { 8, 32, 128 });
+
+    int32 NumSeeds = 10;
+    FParse::Value(*Params, TEXT("Seeds="), NumSeeds);
+    NumSeeds = FMath::Max(NumSeeds, 1);
+
+    EWFCPropagator Propagator = EWFCPropagator::Bitmask;
+    FString PropagatorName = TEXT("Bitmask");
+    if (FParse::Value(*Params, TEXT("Propagator="), PropagatorName) && PropagatorName == TEXT("SupportCount"))
+    {
+        Propagator = EWFCPropagator::SupportCount;
+    }
+
+    FString OutputBase = FPaths::ProjectSavedDir() / TEXT("WFCBenchmark") / (TEXT("WFCBenchmark-") + FDateTime::Now().ToString());
+    FParse::Value(*Params, TEXT("Output="), OutputBase);
+
+    const bool bVerify = Switches.Contains(TEXT("Verify"));
+    double BudgetMs = 0.0;
+    FParse::Value(*Params, TEXT("BudgetMs="), BudgetMs);
+
+    // Solve with the same contradiction handling a freshly placed component would use
+    const UWaveFunctionCollapseComponent* Defaults = GetDefault<UWaveFunctionCollapseComponent>();
+
+    TArray<FBenchmarkResult> Results;
+    FWFCSolver Solver;
+    FWFCSolver VerifySolver;
+    TArray<int32> States;
+    TArray<int32> VerifyStates;
+    bool bPassed = true;
+
+    for (int32 NumTiles : TileCounts)
+    {
+        FWFCSolver::FRulesRef Rules = MakeSyntheticRules(NumTiles, NumTiles);
+
+        for (int32 GridSize : GridSizes)
+        {
+            FBenchmarkResult& Result = Results.AddDefaulted_GetRef();
+            Result.GridSize = GridSize;
+            Result.NumTiles = NumTiles;
+            Result.NumSolves = NumSeeds;
+
+            TArray<double> Milliseconds;
+            double TotalSeconds = 0.0;
+            int64 NumPropagations = 0;
+            int32 NumContradicted = 0;
+            int32 NumFailed = 0;
+
+            for (int32 Seed = 0; Seed < NumSeeds; ++Seed)
+            {
+                FWFCSolverSettings Settings;
+                Settings.Width = GridSize;
+                Settings.Height = GridSize;
+                Settings.Propagator = Propagator;
+                Settings.Seed = Seed;
+                Settings.BacktrackDepth = Defaults->BacktrackDepth;
+                Settings.MaxBacktracks = Defaults->MaxBacktracks;
+                Settings.LocalRestartRadius = Defaults->LocalRestartRadius;
+                Settings.MaxLocalRestarts = Defaults->MaxLocalRestarts;
+
+                // The solver is reused like the component does, so buffers are only allocated once per size
+                const uint64 StartCycles = FPlatformTime::Cycles64();
+                Solver.Init(Rules, Settings);
+                const EWFCSolveStatus Status = Solver.Run();
+                const double Seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+
+                Milliseconds.Add(Seconds * 1000.0);
+                TotalSeconds += Seconds;
+                NumPropagations += Solver.GetStats().NumPropagations;
+                NumContradicted += Solver.GetStats().NumContradictions > 0 ? 1 : 0;
+                NumFailed += Status != EWFCSolveStatus::Completed ? 1 : 0;
+                Result.SolverBytes = FMath::Max<uint64>(Result.SolverBytes, Solver.GetAllocatedSize());
+
+                if (bVerify && Status == EWFCSolveStatus::Completed)
+                {
+                    Solver.GetFinalStates(States);
+                    if (FWFCSolver::FindInvalidCell(*Rules, GridSize, GridSize, States) != -1)
+                    {
+                        ++Result.NumInvalid;
+                    }
+
+                    VerifySolver.Init(Rules, Settings);
+                    VerifySolver.Run();
+                    VerifySolver.GetFinalStates(VerifyStates);
+                    if (VerifyStates != States)
+                    {
+                        ++Result.NumNondeterministic;
+                    }
+                }
+            }
+
+            Milliseconds.Sort();
+            Result.P50Ms = GetPercentile(Milliseconds, 0.5);
+            Result.P99Ms = GetPercentile(Milliseconds, 0.99);
+            Result.MeanMs = TotalSeconds * 1000.0 / NumSeeds;
+            Result.PropagationsPerSecond = TotalSeconds > 0.0 ? NumPropagations / TotalSeconds : 0.0;
+            Result.ContradictionRate = static_cast<double>(NumContradicted) / NumSeeds;
+            Result.FailureRate = static_cast<double>(NumFailed) / NumSeeds;
+            Result.PeakUsedPhysical = FPlatformMemory::GetStats().PeakUsedPhysical;
+
+            UE_LOG(LogTemp, Display, TEXT("WFCBenchmark %dx%d, %d tiles: p50 %.3f ms, p99 %.3f ms, %.0f propagations/s, %.0f%% contradicted, %.0f%% failed"),
+                GridSize, GridSize, NumTiles, Result.P50Ms, Result.P99Ms, Result.PropagationsPerSecond, Result.ContradictionRate * 100.0, Result.FailureRate * 100.0);
+
+            if (Result.NumInvalid > 0 || Result.NumNondeterministic > 0)
+            {
+                UE_LOG(LogTemp, Error, TEXT("WFCBenchmark %dx%d, %d tiles: %d grids break the rules, %d differ when solved again"),
+                    GridSize, GridSize, NumTiles, Result.NumInvalid, Result.NumNondeterministic);
+                bPassed = false;
+            }
+
+            if (BudgetMs > 0.0 && Result.P99Ms > BudgetMs)
+            {
+                UE_LOG(LogTemp, Error, TEXT("WFCBenchmark %dx%d, %d tiles: p99 %.3f ms is over the %.3f ms budget"), GridSize, GridSize, NumTiles, Result.P99Ms, BudgetMs);
+                bPassed = false;
+            }
+        }
+    }
+
+    // Drop the last wave before the report is written
+    Solver.Reset();
+    VerifySolver.Reset();
+
+    FString Csv = TEXT("grid_size,num_tiles,num_solves,p50_ms,p99_ms,mean_ms,propagations_per_second,contradiction_rate,failure_rate,solver_bytes,peak_used_physical,invalid,nondeterministic\n");
+    FString Json = FString::Printf(TEXT("{\n  \"propagator\": \"%s\",\n  \"results\": [\n"), *PropagatorName);
+
+    for (int32 i = 0; i < Results.Num(); ++i)
+    {
+        const FBenchmarkResult& Result = Results[i];
+        Csv += FString::Printf(TEXT("%d,%d,%d,%.4f,%.4f,%.4f,%.1f,%.4f,%.4f,%llu,%llu,%d,%d\n"),
+            Result.GridSize, Result.NumTiles, Result.NumSolves, Result.P50Ms, Result.P99Ms, Result.MeanMs,
+            Result.PropagationsPerSecond, Result.ContradictionRate, Result.FailureRate, Result.SolverBytes, Result.PeakUsedPhysical,
+            Result.NumInvalid, Result.NumNondeterministic);
+
+        Json += FString::Printf(TEXT("    { \"gridSize\": %d, \"numTiles\": %d, \"numSolves\": %d, \"p50Ms\": %.4f, \"p99Ms\": %.4f, \"meanMs\": %.4f, \"propagationsPerSecond\": %.1f, \"contradictionRate\": %.4f, \"failureRate\": %.4f, \"solverBytes\": %llu, \"peakUsedPhysical\": %llu, \"invalid\": %d, \"nondeterministic\": %d }%s\n"),
+            Result.GridSize, Result.NumTiles, Result.NumSolves, Result.P50Ms, Result.P99Ms, Result.MeanMs,
+            Result.PropagationsPerSecond, Result.ContradictionRate, Result.FailureRate, Result.SolverBytes, Result.PeakUsedPhysical,
+            Result.NumInvalid, Result.NumNondeterministic, i + 1 < Results.Num() ? TEXT(",") : TEXT(""));
+    }
+    Json += TEXT("  ]\n}\n");
+
+    if (!FFileHelper::SaveStringToFile(Csv, *(OutputBase + TEXT(".csv"))) || !FFileHelper::SaveStringToFile(Json, *(OutputBase + TEXT(".json"))))
+    {
+        UE_LOG(LogTemp, Error, TEXT("WFCBenchmark could not write the report to %s"), *OutputBase);
+        return 1;
+    }
+
+    UE_LOG(LogTemp, Display, TEXT("WFCBenchmark report written to %s.csv and .json"), *OutputBase);
+    return bPassed ? 0 : 1;
+}
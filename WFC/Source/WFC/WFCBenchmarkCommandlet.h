@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "WFCBenchmarkCommandlet.generated.h"
+
+// Runs the solver without spawning anything over a matrix of grid sizes, synthetic tile sets and seeds,
+// and writes timing, throughput, contradiction and memory figures to Saved/WFCBenchmark.
+// With -Verify every solved grid is checked against the rules and solved a second time to check determinism,
+// and -BudgetMs fails the run when a p99 solve time goes over budget, so the commandlet can gate builds.
+// Usage: UnrealEditor-Cmd WFC.uproject -run=WFCBenchmark [-Sizes=16,32,64] [-Tiles=8,32,128] [-Seeds=10]
+//        [-Propagator=Bitmask|SupportCount] [-Output=BaseFilePath] [-Verify] [-BudgetMs=N]
+UCLASS()
+class UWFCBenchmarkCommandlet : public UCommandlet
+{
+    GENERATED_BODY()
+
+public:
+    UWFCBenchmarkCommandlet();
+
+    virtual int32 Main(const FString& Params) override;
+};
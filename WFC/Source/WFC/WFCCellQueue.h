@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WFCWave.h"
+
+// Fixed-capacity FIFO of cell indices with an in-queue bitmap.
+// A cell can only be queued once at a time, so a capacity of one slot per cell never overflows.
+// Storage is kept between generations and only grows when the grid does.
+struct FWFCCellQueue
+{
+    // Size the queue for a grid and empty it
+    void Init(int32 NumCells)
+    {
+        Buffer.SetNumUninitialized(NumCells, EAllowShrinking::No);
+        InQueue.SetNumZeroed(FMath::DivideAndRoundUp(NumCells, 64), EAllowShrinking::No);
+        FMemory::Memzero(InQueue.GetData(), InQueue.Num() * sizeof(uint64));
+        Head = 0;
+        Count = 0;
+    }
+
+    // Append a cell unless it is already queued; returns true if it was added
+    bool Push(int32 Cell)
+    {
+        if (WFCBits::Test(InQueue.GetData(), Cell))
+            return false;
+
+        WFCBits::Set(InQueue.GetData(), Cell);
+
+        int32 Tail = Head + Count;
+        if (Tail >= Buffer.Num())
+        {
+            Tail -= Buffer.Num();
+        }
+
+        Buffer[Tail] = Cell;
+        ++Count;
+        return true;
+    }
+
+    // Remove and return the oldest queued cell
+    int32 Pop()
+    {
+        check(Count > 0);
+
+        const int32 Cell = Buffer[Head];
+        WFCBits::Clear(InQueue.GetData(), Cell);
+
+        if (++Head == Buffer.Num())
+        {
+            Head = 0;
+        }
+        --Count;
+        return Cell;
+    }
+
+    // Drop every queued cell
+    void Clear()
+    {
+        while (Count > 0)
+        {
+            Pop();
+        }
+    }
+
+    bool IsEmpty() const { return Count == 0; }
+
+    int32 Num() const { return Count; }
+
+    SIZE_T GetAllocatedSize() const { return Buffer.GetAllocatedSize() + InQueue.GetAllocatedSize(); }
+
+private:
+    // Ring buffer with one slot per cell
+    TArray<int32> Buffer;
+
+    // One bit per cell, set while the cell is queued
+    TArray<uint64> InQueue;
+
+    int32 Head = 0;
+    int32 Count = 0;
+};
@@ -0,0 +1,454 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCChunkedWorldComponent.h"
+#include "WaveFunctionCollapseComponent.h"
+#include "WFCStats.h"
+#include "WFCSolverPool.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "Async/Async.h"
+#include "Tasks/Task.h"
+
+// Sets default values for this component's properties
+UWFCChunkedWorldComponent::UWFCChunkedWorldComponent()
+{
+    // Ticking streams chunks in and out around the focus actor
+    PrimaryComponentTick.bCanEverTick = true;
+}
+
+
+// Called when the game starts
+void UWFCChunkedWorldComponent::BeginPlay()
+{
+    Super::BeginPlay();
+
+    TileSource = GetOwner()->FindComponentByClass<UWaveFunctionCollapseComponent>();
+
+    if (!TileSource || !TileSource->CompileRules())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Chunked Wave Function Collapse needs a valid WaveFunctionCollapseComponent on the same actor"));
+        SetComponentTickEnabled(false);
+        return;
+    }
+
+    Rules = TileSource->GetCompiledRules();
+}
+
+
+// Called when the component is removed from play
+void UWFCChunkedWorldComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    ClearChunks();
+
+    Super::EndPlay(EndPlayReason);
+}
+
+
+// Called every frame
+void UWFCChunkedWorldComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+    Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+    if (!Rules)
+        return;
+
+    AActor* Focus = FocusActor ? FocusActor.Get() : UGameplayStatics::GetPlayerPawn(this, 0);
+    if (!Focus)
+        return;
+
+    const FIntPoint Center = GetChunkCoord(Focus->GetActorLocation());
+
+    // Evict chunks that fell out of range, with one chunk of slack so they don't thrash at the edge
+    auto IsOutOfRange = [this, Center](const FIntPoint& Coord)
+    {
+        const FIntPoint Offset = Coord - Center;
+        return FMath::Max(FMath::Abs(Offset.X), FMath::Abs(Offset.Y)) > ViewDistance + 1;
+    };
+
+    for (auto It = Chunks.CreateIterator(); It; ++It)
+    {
+        if (IsOutOfRange(It.Key()))
+        {
+            DestroyChunk(It.Key(), It.Value());
+            It.RemoveCurrent();
+        }
+    }
+
+    for (auto It = PendingChunks.CreateIterator(); It; ++It)
+    {
+        if (IsOutOfRange(It.Key()))
+        {
+            It.Value()->bCancelled = true;
+            It.RemoveCurrent();
+        }
+    }
+
+    // Show the chunks solved since the last tick; chunks cancelled meanwhile are no longer pending
+    int32 NumShown = 0;
+    while (SolvedChunks.Num() > 0 && NumShown < MaxChunksPerTick)
+    {
+        TPair<FChunkJobPtr, TArray<int32>> Solved = MoveTemp(SolvedChunks[0]);
+        SolvedChunks.RemoveAt(0, EAllowShrinking::No);
+
+        const FIntPoint Coord = Solved.Key->Coord;
+        if (PendingChunks.FindRef(Coord) != Solved.Key)
+            continue;
+
+        PendingChunks.Remove(Coord);
+        FWFCChunk& Chunk = Chunks.Add(Coord);
+        Chunk.FinalStates = MoveTemp(Solved.Value);
+        SpawnChunk(Coord, Chunk);
+        ++NumShown;
+    }
+
+    // Load the missing chunks closest to the focus first
+    TArray<FIntPoint, TInlineAllocator<64>> Missing;
+    for (int32 DY = -ViewDistance; DY <= ViewDistance; ++DY)
+    {
+        for (int32 DX = -ViewDistance; DX <= ViewDistance; ++DX)
+        {
+            const FIntPoint Coord = Center + FIntPoint(DX, DY);
+            if (!Chunks.Contains(Coord) && !PendingChunks.Contains(Coord))
+            {
+                Missing.Add(Coord);
+            }
+        }
+    }
+
+    Missing.Sort([Center](const FIntPoint& A, const FIntPoint& B)
+    {
+        return (A - Center).SizeSquared() < (B - Center).SizeSquared();
+    });
+
+    int32 NumStarted = 0;
+    for (const FIntPoint& Coord : Missing)
+    {
+        if (NumStarted >= MaxChunksPerTick || PendingChunks.Num() >= MaxPendingChunks)
+            break;
+
+        // A chunk waits for the chunks it shares a seam with, so it is matched against their final edges
+        if (IsNeighborPending(Coord))
+            continue;
+
+        GenerateChunk(Coord);
+        ++NumStarted;
+    }
+}
+
+void UWFCChunkedWorldComponent::ClearChunks()
+{
+    for (TPair<FIntPoint, FWFCChunk>& Pair : Chunks)
+    {
+        DestroyChunk(Pair.Key, Pair.Value);
+    }
+
+    for (TPair<FIntPoint, FChunkJobPtr>& Pair : PendingChunks)
+    {
+        Pair.Value->bCancelled = true;
+    }
+
+    Chunks.Empty();
+    PendingChunks.Empty();
+    SolvedChunks.Empty();
+}
+
+FIntPoint UWFCChunkedWorldComponent::GetChunkCoord(const FVector& Location) const
+{
+    const FVector Local = Location - GetOwner()->GetActorLocation();
+    const float ChunkExtent = ChunkSize * TileSource->TileSize;
+
+    return FIntPoint(FMath::FloorToInt(Local.X / ChunkExtent), FMath::FloorToInt(Local.Y / ChunkExtent));
+}
+
+// Chunks sharing a seam with a chunk, and the side of the chunk each of them is on
+static const TPair<FIntPoint, EWFCDirection> ChunkSides[] =
+{
+    { FIntPoint(0, -1), EWFCDirection::North },
+    { FIntPoint(1, 0),  EWFCDirection::East },
+    { FIntPoint(0, 1),  EWFCDirection::South },
+    { FIntPoint(-1, 0), EWFCDirection::West }
+};
+
+bool UWFCChunkedWorldComponent::IsNeighborPending(const FIntPoint& Coord) const
+{
+    for (const TPair<FIntPoint, EWFCDirection>& Side : ChunkSides)
+    {
+        if (PendingChunks.Contains(Coord + Side.Key))
+            return true;
+    }
+    return false;
+}
+
+void UWFCChunkedWorldComponent::GenerateChunk(const FIntPoint& Coord)
+{
+    FChunkJobPtr Job = MakeShared<FChunkJob, ESPMode::ThreadSafe>();
+    Job->Coord = Coord;
+
+    FWFCSolverSettings& Settings = Job->Settings;
+    Settings.Width = ChunkSize;
+    Settings.Height = ChunkSize;
+    Settings.Propagator = TileSource->Propagator;
+    // Each chunk has its own stream, so its content only depends on the seed, its coordinate and its loaded neighbors
+    Settings.Seed = FWFCSolver::DeriveSeed(TileSource->Seed, GetTypeHash(Coord));
+    Settings.BacktrackDepth = TileSource->BacktrackDepth;
+    Settings.MaxBacktracks = TileSource->MaxBacktracks;
+    Settings.LocalRestartRadius = TileSource->LocalRestartRadius;
+    Settings.MaxLocalRestarts = TileSource->MaxLocalRestarts;
+
+    // Copy the neighbors' cells along the seams, so the worker never reads the chunk map
+    const int32 Last = ChunkSize - 1;
+    for (const TPair<FIntPoint, EWFCDirection>& Side : ChunkSides)
+    {
+        const FWFCChunk* Neighbor = Chunks.Find(Coord + Side.Key);
+        if (!Neighbor || Neighbor->FinalStates.Num() != ChunkSize * ChunkSize)
+            continue;
+
+        TArray<int32>& Border = Job->NeighborBorders[static_cast<int32>(Side.Value)];
+        Border.SetNumUninitialized(ChunkSize);
+
+        for (int32 i = 0; i < ChunkSize; ++i)
+        {
+            FIntPoint NeighborCell;
+            switch (Side.Value)
+            {
+            case EWFCDirection::North: NeighborCell = FIntPoint(i, Last); break;
+            case EWFCDirection::East:  NeighborCell = FIntPoint(0, i);    break;
+            case EWFCDirection::South: NeighborCell = FIntPoint(i, 0);    break;
+            default:                   NeighborCell = FIntPoint(Last, i); break;
+            }
+            Border[i] = Neighbor->FinalStates[NeighborCell.Y * ChunkSize + NeighborCell.X];
+        }
+    }
+
+    PendingChunks.Add(Coord, Job);
+
+    FWFCSolver::FRulesRef ChunkRules = Rules.ToSharedRef();
+    TWeakObjectPtr<UWFCChunkedWorldComponent> WeakThis(this);
+
+    UE::Tasks::Launch(UE_SOURCE_LOCATION, [WeakThis, Job, ChunkRules]()
+    {
+        // Pooled like the solvers of asynchronous generations, so streaming doesn't allocate a wave per chunk
+        FWFCSolverPool::FScopedSolver Solver;
+        const EWFCSolveStatus Status = SolveChunk(*Solver, ChunkRules, *Job);
+        if (Status == EWFCSolveStatus::Cancelled)
+            return;
+
+        if (Status != EWFCSolveStatus::Completed)
+        {
+            UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse chunk (%d, %d) may be incomplete."), Job->Coord.X, Job->Coord.Y);
+        }
+
+        TArray<int32> States;
+        Solver->GetFinalStates(States);
+
+        AsyncTask(ENamedThreads::GameThread, [WeakThis, Job, States = MoveTemp(States)]() mutable
+        {
+            if (UWFCChunkedWorldComponent* This = WeakThis.Get())
+            {
+                This->FinishChunk(Job, MoveTemp(States));
+            }
+        });
+    });
+}
+
+EWFCSolveStatus UWFCChunkedWorldComponent::SolveChunk(FWFCSolver& Solver, FWFCSolver::FRulesRef ChunkRules, const FChunkJob& Job)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(WFC_GenerateChunk);
+    SCOPE_CYCLE_COUNTER(STAT_WFC_Solve);
+
+    Solver.Init(ChunkRules, Job.Settings);
+
+    // Seed the borders from every loaded neighbor, then propagate them together
+    int32 NumUnmatched = 0;
+    for (int32 Side = 0; Side < FWFCCompiledRules::NumHorizontalDirections; ++Side)
+    {
+        if (Job.NeighborBorders[Side].Num() > 0)
+        {
+            NumUnmatched += ConstrainChunkBorder(Solver, *ChunkRules, Job, static_cast<EWFCDirection>(Side));
+        }
+    }
+
+    if (NumUnmatched > 0)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse chunk (%d, %d) has %d border cells that no tile fits between its neighbors; its seams won't match there"),
+            Job.Coord.X, Job.Coord.Y, NumUnmatched);
+    }
+
+    Solver.PropagatePendingConstraints();
+    return Solver.Run(&Job.bCancelled);
+}
+
+int32 UWFCChunkedWorldComponent::ConstrainChunkBorder(FWFCSolver& Solver, const FWFCCompiledRules& ChunkRules, const FChunkJob& Job, EWFCDirection Side)
+{
+    const int32 Size = Job.Settings.Width;
+    const int32 Last = Size - 1;
+    const TArray<int32>& Border = Job.NeighborBorders[static_cast<int32>(Side)];
+
+    // Border cells of the new chunk see the neighbor's cells in the opposite direction
+    const EWFCDirection TowardsChunk = FWFCCompiledRules::GetOppositeDirection(Side);
+
+    int32 NumUnmatched = 0;
+    for (int32 i = 0; i < Size; ++i)
+    {
+        FIntPoint Cell;
+        switch (Side)
+        {
+        case EWFCDirection::North: Cell = FIntPoint(i, 0);    break;
+        case EWFCDirection::East:  Cell = FIntPoint(Last, i); break;
+        case EWFCDirection::South: Cell = FIntPoint(i, Last); break;
+        default:                   Cell = FIntPoint(0, i);    break;
+        }
+
+        const int32 NeighborTile = Border[i];
+        if (NeighborTile < 0 || NeighborTile >= ChunkRules.GetNumTiles())
+            continue;
+
+        // Fails where the neighbors on two sides of a corner cell leave it no tile; the cell then only fits one of them
+        if (!Solver.ConstrainCell(Solver.XYToIndex(Cell.X, Cell.Y), ChunkRules.GetAllowedNeighbors(NeighborTile, TowardsChunk)))
+        {
+            UE_LOG(LogTemp, Verbose, TEXT("Wave Function Collapse chunk (%d, %d) cell (%d, %d) has no tile fitting its neighbor"), Job.Coord.X, Job.Coord.Y, Cell.X, Cell.Y);
+            ++NumUnmatched;
+        }
+    }
+
+    return NumUnmatched;
+}
+
+void UWFCChunkedWorldComponent::FinishChunk(const FChunkJobPtr& Job, TArray<int32>&& States)
+{
+    if (Job->bCancelled || PendingChunks.FindRef(Job->Coord) != Job)
+        return;
+
+    SolvedChunks.Emplace(Job, MoveTemp(States));
+}
+
+FVector UWFCChunkedWorldComponent::GetCellLocation(const FIntPoint& Coord, int32 CellIndex) const
+{
+    const float TileSize = TileSource->TileSize;
+    const int32 X = Coord.X * ChunkSize + CellIndex % ChunkSize;
+    const int32 Y = Coord.Y * ChunkSize + CellIndex / ChunkSize;
+    return GetOwner()->GetActorLocation() + FVector(X * TileSize, Y * TileSize, 0);
+}
+
+void UWFCChunkedWorldComponent::SpawnChunk(const FIntPoint& Coord, FWFCChunk& Chunk)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(WFC_SpawnChunk);
+    SCOPE_CYCLE_COUNTER(STAT_WFC_SpawnTileMeshes);
+
+    const TArray<FTileType>& TileTypes = TileSource->TileTypes;
+    FreeInstances.SetNum(FMath::Max(FreeInstances.Num(), TileTypes.Num()));
+    Chunk.Instances.Init(INDEX_NONE, Chunk.FinalStates.Num());
+
+    // Cells that find no parked instance are grouped by tile type, so each component gets its new instances in one call.
+    // Rotated and reflected variants share the component of their tile type.
+    TArray<TArray<int32>> DeferredCells;
+    TArray<TArray<FTransform>> DeferredTransforms;
+    DeferredCells.SetNum(TileTypes.Num());
+    DeferredTransforms.SetNum(TileTypes.Num());
+    TBitArray<> Touched(false, TileTypes.Num());
+
+    for (int32 i = 0; i < Chunk.FinalStates.Num(); ++i)
+    {
+        const int32 FinalState = Chunk.FinalStates[i];
+        if (FinalState < 0 || FinalState >= Rules->GetNumTiles())
+            continue;
+
+        const FWFCTileVariant& Variant = Rules->GetVariant(FinalState);
+        const int32 SourceTile = Variant.SourceTile;
+        if (!TileTypes.IsValidIndex(SourceTile) || !TileTypes[SourceTile].Mesh)
+            continue;
+
+        const FTransform Transform = Variant.MakeTransform(GetCellLocation(Coord, i));
+        Touched[SourceTile] = true;
+
+        TArray<int32>& Free = FreeInstances[SourceTile];
+        if (Free.Num() > 0)
+        {
+            const int32 InstanceIndex = Free.Pop(EAllowShrinking::No);
+            GetTileInstances(SourceTile)->UpdateInstanceTransform(InstanceIndex, Transform, false, false, true);
+            Chunk.Instances[i] = InstanceIndex;
+        }
+        else
+        {
+            DeferredCells[SourceTile].Add(i);
+            DeferredTransforms[SourceTile].Add(Transform);
+        }
+    }
+
+    for (int32 TileIndex = 0; TileIndex < TileTypes.Num(); ++TileIndex)
+    {
+        if (DeferredCells[TileIndex].Num() > 0)
+        {
+            const TArray<int32> Indices = GetTileInstances(TileIndex)->AddInstances(DeferredTransforms[TileIndex], true);
+            for (int32 i = 0; i < Indices.Num(); ++i)
+            {
+                Chunk.Instances[DeferredCells[TileIndex][i]] = Indices[i];
+            }
+        }
+
+        if (Touched[TileIndex])
+        {
+            TileInstances[TileIndex]->MarkRenderStateDirty();
+        }
+    }
+}
+
+void UWFCChunkedWorldComponent::DestroyChunk(const FIntPoint& Coord, FWFCChunk& Chunk)
+{
+    TBitArray<> Touched(false, TileInstances.Num());
+
+    for (int32 i = 0; i < Chunk.Instances.Num(); ++i)
+    {
+        const int32 InstanceIndex = Chunk.Instances[i];
+        if (InstanceIndex == INDEX_NONE)
+            continue;
+
+        const int32 SourceTile = Rules->GetVariant(Chunk.FinalStates[i]).SourceTile;
+        UInstancedStaticMeshComponent* Instances = TileInstances.IsValidIndex(SourceTile) ? TileInstances[SourceTile].Get() : nullptr;
+        if (!Instances)
+            continue;
+
+        // Removing an instance renumbers others, so park it at zero scale for the next chunk instead
+        const FTransform Parked(FQuat::Identity, GetCellLocation(Coord, i), FVector::ZeroVector);
+        if (Instances->UpdateInstanceTransform(InstanceIndex, Parked, false, false, true))
+        {
+            FreeInstances[SourceTile].Add(InstanceIndex);
+            Touched[SourceTile] = true;
+        }
+    }
+
+    for (int32 TileIndex = 0; TileIndex < TileInstances.Num(); ++TileIndex)
+    {
+        if (Touched[TileIndex])
+        {
+            TileInstances[TileIndex]->MarkRenderStateDirty();
+        }
+    }
+
+    Chunk.Instances.Empty();
+    Chunk.FinalStates.Empty();
+}
+
+UInstancedStaticMeshComponent* UWFCChunkedWorldComponent::GetTileInstances(int32 TileIndex)
+{
+    if (TileInstances.Num() <= TileIndex)
+    {
+        TileInstances.SetNum(TileIndex + 1);
+    }
+
+    TObjectPtr<UInstancedStaticMeshComponent>& Instances = TileInstances[TileIndex];
+    if (!Instances)
+    {
+        // The output mode is taken once, since the chunks' instance indices point into these components
+        const bool bHierarchical = TileSource->OutputMode == EWFCOutputMode::HierarchicalInstancedStaticMesh;
+        UClass* InstancesClass = bHierarchical ? UHierarchicalInstancedStaticMeshComponent::StaticClass() : UInstancedStaticMeshComponent::StaticClass();
+
+        Instances = NewObject<UInstancedStaticMeshComponent>(GetOwner(), InstancesClass);
+        Instances->SetStaticMesh(TileSource->TileTypes[TileIndex].Mesh);
+        Instances->RegisterComponent();
+    }
+
+    return Instances;
+}
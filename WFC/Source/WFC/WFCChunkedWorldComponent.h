@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "WFCSolver.h"
+#include "WFCChunkedWorldComponent.generated.h"
+
+class UInstancedStaticMeshComponent;
+class UWaveFunctionCollapseComponent;
+
+// A solved chunk of the streamed world
+USTRUCT()
+struct FWFCChunk
+{
+    GENERATED_USTRUCT_BODY()
+
+    // Tile index of every cell of the chunk, row-major
+    TArray<int32> FinalStates;
+
+    // Instance index of every cell in the shared instanced component of its tile type, INDEX_NONE where nothing is shown
+    TArray<int32> Instances;
+};
+
+// Streams an unbounded grid around a focus actor in fixed-size chunks.
+// The tile set and spacing come from a UWaveFunctionCollapseComponent on the same actor.
+// Each new chunk has its border cells constrained by the already collapsed edges of the
+// loaded chunks around it, so tiles match across chunk seams. Chunks are solved on worker
+// threads in pooled solvers, and their tiles share one instanced component per tile type.
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class WFC_API UWFCChunkedWorldComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UWFCChunkedWorldComponent();
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+
+	// Called when the component is removed from play
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	// Called every frame
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+    // Actor the world is streamed around; the first player pawn is used when unset
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Chunks")
+    TObjectPtr<AActor> FocusActor;
+
+    // Number of cells along each side of a chunk
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Chunks", meta = (ClampMin = "1"))
+    int32 ChunkSize = 16;
+
+    // Chunks within this many chunks of the focus chunk are kept loaded
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Chunks", meta = (ClampMin = "0"))
+    int32 ViewDistance = 3;
+
+    // Upper bound on chunks started and shown in one frame, to keep hitches small
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Chunks", meta = (ClampMin = "1"))
+    int32 MaxChunksPerTick = 1;
+
+    // Upper bound on chunks being solved on worker threads at the same time
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Chunks", meta = (ClampMin = "1"))
+    int32 MaxPendingChunks = 4;
+
+    // Unload every chunk
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse|Chunks")
+    void ClearChunks();
+
+    // Number of chunks currently loaded
+    UFUNCTION(BlueprintPure, Category = "WaveFunctionCollapse|Chunks")
+    int32 GetNumLoadedChunks() const { return Chunks.Num(); }
+
+    // Number of chunks still being solved
+    UFUNCTION(BlueprintPure, Category = "WaveFunctionCollapse|Chunks")
+    int32 GetNumPendingChunks() const { return PendingChunks.Num(); }
+
+private:
+    // A chunk solved on a worker thread, with everything it needs copied from the game thread
+    struct FChunkJob
+    {
+        FIntPoint Coord = FIntPoint::ZeroValue;
+        FWFCSolverSettings Settings;
+
+        // Tiles of the loaded neighbors' cells facing the chunk, indexed by EWFCDirection; empty where no neighbor is loaded
+        TArray<int32> NeighborBorders[FWFCCompiledRules::NumHorizontalDirections];
+
+        std::atomic<bool> bCancelled { false };
+    };
+
+    typedef TSharedPtr<FChunkJob, ESPMode::ThreadSafe> FChunkJobPtr;
+
+    // Component providing the tile set
+    UPROPERTY(Transient)
+    TObjectPtr<UWaveFunctionCollapseComponent> TileSource;
+
+    // Loaded chunks by chunk coordinate
+    UPROPERTY(Transient)
+    TMap<FIntPoint, FWFCChunk> Chunks;
+
+    // Chunks being solved or waiting to be shown, by coordinate
+    TMap<FIntPoint, FChunkJobPtr> PendingChunks;
+
+    // Solved chunks waiting to be shown, so no more than MaxChunksPerTick are spawned in one frame
+    TArray<TPair<FChunkJobPtr, TArray<int32>>> SolvedChunks;
+
+    // Instanced components shared by every chunk, indexed by tile type
+    UPROPERTY(Transient)
+    TArray<TObjectPtr<UInstancedStaticMeshComponent>> TileInstances;
+
+    // Instances of unloaded chunks parked at zero scale per tile type, reused before new ones are added
+    TArray<TArray<int32>> FreeInstances;
+
+    // Rules compiled from the tile source when play began
+    TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> Rules;
+
+    // Chunk coordinate containing a world location
+    FIntPoint GetChunkCoord(const FVector& Location) const;
+
+    // Is a chunk sharing a seam with Coord still being solved?
+    bool IsNeighborPending(const FIntPoint& Coord) const;
+
+    // Start solving a chunk on a worker thread, matching the edges of its loaded neighbors
+    void GenerateChunk(const FIntPoint& Coord);
+
+    // Solve the chunk of a job into Solver; runs on a worker thread
+    static EWFCSolveStatus SolveChunk(FWFCSolver& Solver, FWFCSolver::FRulesRef ChunkRules, const FChunkJob& Job);
+
+    // Constrain the border cells of the solver's chunk against the border of one loaded neighbor.
+    // Returns the number of cells no tile fits, which are left unconstrained.
+    static int32 ConstrainChunkBorder(FWFCSolver& Solver, const FWFCCompiledRules& ChunkRules, const FChunkJob& Job, EWFCDirection Side);
+
+    // Queue a solved chunk to be shown by the next ticks, unless it was cancelled since
+    void FinishChunk(const FChunkJobPtr& Job, TArray<int32>&& States);
+
+    // Show the tiles of a solved chunk with pooled instances
+    void SpawnChunk(const FIntPoint& Coord, FWFCChunk& Chunk);
+
+    // Park the instances of a chunk for later chunks to reuse
+    void DestroyChunk(const FIntPoint& Coord, FWFCChunk& Chunk);
+
+    // World location of a cell of a chunk
+    FVector GetCellLocation(const FIntPoint& Coord, int32 CellIndex) const;
+
+    // Get the shared instanced component for a tile type, creating it if needed
+    UInstancedStaticMeshComponent* GetTileInstances(int32 TileIndex);
+};
@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCConstraints.h"
+#include "Hash/CityHash.h"
+
+void FWFCInitialConstraints::Init(int32 InNumWords)
+{
+    NumWords = InNumWords;
+    CellOffsets.Reset();
+    Masks.Reset();
+}
+
+void FWFCInitialConstraints::Constrain(int32 Cell, const uint64* Mask)
+{
+    if (const int32* Offset = CellOffsets.Find(Cell))
+    {
+        for (int32 Word = 0; Word < NumWords; ++Word)
+        {
+            Masks[*Offset + Word] &= Mask[Word];
+        }
+        return;
+    }
+
+    CellOffsets.Add(Cell, Masks.Num());
+    Masks.Append(Mask, NumWords);
+}
+
+void FWFCInitialConstraints::ExtractBox(int32 Width, int32 Height, const FIntVector& Min, const FIntVector& Size, FWFCInitialConstraints& OutConstraints) const
+{
+    OutConstraints.Init(NumWords);
+
+    ForEach([&](int32 Cell, const uint64* Mask)
+    {
+        const FIntVector Local = FIntVector(Cell % Width, (Cell / Width) % Height, Cell / (Width * Height)) - Min;
+        if (Local.X >= 0 && Local.X < Size.X && Local.Y >= 0 && Local.Y < Size.Y && Local.Z >= 0 && Local.Z < Size.Z)
+        {
+            OutConstraints.Constrain((Local.Z * Size.Y + Local.Y) * Size.X + Local.X, Mask);
+        }
+    });
+}
+
+uint64 FWFCInitialConstraints::GetHash() const
+{
+    uint64 Hash = CityHash64(reinterpret_cast<const char*>(&NumWords), sizeof(NumWords));
+    ForEach([&Hash, this](int32 Cell, const uint64* Mask)
+    {
+        Hash = CityHash64WithSeed(reinterpret_cast<const char*>(&Cell), sizeof(Cell), Hash);
+        Hash = CityHash64WithSeed(reinterpret_cast<const char*>(Mask), NumWords * sizeof(uint64), Hash);
+    });
+    return Hash;
+}
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Tile masks applied to cells before a solve starts, e.g. fixed or banned tiles and grid boundaries.
+// The solver applies all of them at once in Init and propagates them in a single pass.
+// Constraints are kept on local restart, so a restart never undoes them.
+struct WFC_API FWFCInitialConstraints
+{
+    // Size the masks for a tile set and drop every constraint
+    void Init(int32 InNumWords);
+
+    // Restrict a cell, by grid index, to the tiles set in Mask; several masks on one cell are combined
+    void Constrain(int32 Cell, const uint64* Mask);
+
+    // Combined mask of a cell, or null if it has no constraint
+    const uint64* Find(int32 Cell) const
+    {
+        const int32* Offset = CellOffsets.Find(Cell);
+        return Offset ? &Masks[*Offset] : nullptr;
+    }
+
+    // Call Func with the grid index and combined mask of every constrained cell, in the order they were first constrained
+    template<typename FuncType>
+    void ForEach(FuncType&& Func) const
+    {
+        for (const TPair<int32, int32>& Pair : CellOffsets)
+        {
+            Func(Pair.Key, &Masks[Pair.Value]);
+        }
+    }
+
+    // The constraints of the cells inside a box of a Width x Height grid,
+    // with grid indices of a grid the size of the box
+    void ExtractBox(int32 Width, int32 Height, const FIntVector& Min, const FIntVector& Size, FWFCInitialConstraints& OutConstraints) const;
+
+    int32 Num() const { return CellOffsets.Num(); }
+    bool IsEmpty() const { return CellOffsets.Num() == 0; }
+    int32 GetNumWords() const { return NumWords; }
+
+    // Hash of every constrained cell and its mask
+    uint64 GetHash() const;
+
+private:
+    int32 NumWords = 0;
+
+    // Offset of each constrained cell's mask in Masks
+    TMap<int32, int32> CellOffsets;
+
+    // NumWords words per constrained cell
+    TArray<uint64> Masks;
+};
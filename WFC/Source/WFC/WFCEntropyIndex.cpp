@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCEntropyIndex.h"
+
+void FWFCEntropyIndex::Init(int32 NumCells, float InitialEntropy)
+{
+    Keys.SetNumUninitialized(NumCells, EAllowShrinking::No);
+    Positions.SetNumUninitialized(NumCells, EAllowShrinking::No);
+    Heap.SetNumUninitialized(NumCells, EAllowShrinking::No);
+
+    // Equal keys already satisfy the heap property
+    for (int32 Cell = 0; Cell < NumCells; ++Cell)
+    {
+        Keys[Cell] = InitialEntropy;
+        Positions[Cell] = Cell;
+        Heap[Cell] = Cell;
+    }
+}
+
+void FWFCEntropyIndex::Init(float BaseEntropy, TArrayView<const float> Offsets)
+{
+    const int32 NumCells = Offsets.Num();
+    Keys.SetNumUninitialized(NumCells, EAllowShrinking::No);
+    Positions.SetNumUninitialized(NumCells, EAllowShrinking::No);
+    Heap.SetNumUninitialized(NumCells, EAllowShrinking::No);
+
+    for (int32 Cell = 0; Cell < NumCells; ++Cell)
+    {
+        Keys[Cell] = BaseEntropy + Offsets[Cell];
+        Place(Cell, Cell);
+    }
+
+    // Heapify bottom up, which is linear in the number of cells
+    for (int32 Slot = NumCells / 2 - 1; Slot >= 0; --Slot)
+    {
+        SiftDown(Slot);
+    }
+}
+
+void FWFCEntropyIndex::Update(int32 Cell, float Entropy)
+{
+    const int32 Slot = Positions[Cell];
+    const float PreviousEntropy = Keys[Cell];
+    Keys[Cell] = Entropy;
+
+    if (Slot == INDEX_NONE)
+    {
+        Place(Heap.Add(Cell), Cell);
+        SiftUp(Heap.Num() - 1);
+    }
+    else if (Entropy < PreviousEntropy)
+    {
+        SiftUp(Slot);
+    }
+    else if (Entropy > PreviousEntropy)
+    {
+        SiftDown(Slot);
+    }
+}
+
+void FWFCEntropyIndex::Remove(int32 Cell)
+{
+    const int32 Slot = Positions[Cell];
+    if (Slot == INDEX_NONE)
+        return;
+
+    Positions[Cell] = INDEX_NONE;
+
+    // Fill the hole with the last entry and restore the heap around it
+    const int32 Last = Heap.Pop(EAllowShrinking::No);
+    if (Slot < Heap.Num())
+    {
+        Place(Slot, Last);
+        SiftUp(Slot);
+        SiftDown(Positions[Last]);
+    }
+}
+
+void FWFCEntropyIndex::SiftUp(int32 Slot)
+{
+    const int32 Cell = Heap[Slot];
+    const float Key = Keys[Cell];
+
+    while (Slot > 0)
+    {
+        const int32 Parent = (Slot - 1) / 2;
+        if (Keys[Heap[Parent]] <= Key)
+            break;
+
+        Place(Slot, Heap[Parent]);
+        Slot = Parent;
+    }
+
+    Place(Slot, Cell);
+}
+
+void FWFCEntropyIndex::SiftDown(int32 Slot)
+{
+    const int32 Cell = Heap[Slot];
+    const float Key = Keys[Cell];
+    const int32 Count = Heap.Num();
+
+    while (true)
+    {
+        int32 Child = Slot * 2 + 1;
+        if (Child >= Count)
+            break;
+
+        // Pick the smaller of the two children
+        if (Child + 1 < Count && Keys[Heap[Child + 1]] < Keys[Heap[Child]])
+        {
+            ++Child;
+        }
+
+        if (Key <= Keys[Heap[Child]])
+            break;
+
+        Place(Slot, Heap[Child]);
+        Slot = Child;
+    }
+
+    Place(Slot, Cell);
+}
+
+void FWFCEntropyIndex::Place(int32 Slot, int32 Cell)
+{
+    Heap[Slot] = Cell;
+    Positions[Cell] = Slot;
+}
@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Min-heap of the uncollapsed cells keyed by entropy.
+// Each cell knows its heap slot, so a change of entropy is repositioned in O(log N)
+// and the lowest entropy cell is read in O(1).
+struct WFC_API FWFCEntropyIndex
+{
+    // Fill the index with cells [0, NumCells) that all share the same entropy
+    void Init(int32 NumCells, float InitialEntropy);
+
+    // Fill the index with one cell per entry of Offsets, keyed by BaseEntropy plus the cell's offset
+    void Init(float BaseEntropy, TArrayView<const float> Offsets);
+
+    // Insert a cell or move it to match its new entropy
+    void Update(int32 Cell, float Entropy);
+
+    // Take a cell out of the index once it is collapsed
+    void Remove(int32 Cell);
+
+    // Cell with the lowest entropy, or -1 if the index is empty
+    int32 GetLowest() const { return Heap.Num() > 0 ? Heap[0] : -1; }
+
+    // Number of cells still waiting to be collapsed
+    int32 Num() const { return Heap.Num(); }
+
+    bool IsEmpty() const { return Heap.Num() == 0; }
+
+    bool Contains(int32 Cell) const { return Positions[Cell] != INDEX_NONE; }
+
+    SIZE_T GetAllocatedSize() const { return Heap.GetAllocatedSize() + Keys.GetAllocatedSize() + Positions.GetAllocatedSize(); }
+
+private:
+    void SiftUp(int32 Slot);
+    void SiftDown(int32 Slot);
+    void Place(int32 Slot, int32 Cell);
+
+    // Heap ordered by Keys, holding cell indices
+    TArray<int32> Heap;
+
+    // Entropy of each cell
+    TArray<float> Keys;
+
+    // Heap slot of each cell, INDEX_NONE when not in the heap
+    TArray<int32> Positions;
+};
@@ -0,0 +1,213 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCGridFile.h"
+#include "Async/Async.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Tasks/Task.h"
+
+namespace
+{
+    constexpr uint32 GridFileMagic = 0x47434657; // "WFCG"
+    constexpr uint16 GridFileVersion = 2;
+
+    // Version 1 files have no depth in their header and are read as a single layer
+    constexpr uint16 GridFileFlatVersion = 1;
+
+    // Header flags
+    constexpr uint16 GridFileCompressed = 1 << 0;
+
+    // Indices are stored shifted up by one so that empty cells pack to 0
+    uint8 GetBitsPerCell(int32 NumTiles)
+    {
+        return static_cast<uint8>(FMath::Max<uint32>(1, FMath::CeilLogTwo(static_cast<uint32>(NumTiles) + 1)));
+    }
+
+    int32 GetPackedSize(int32 NumCells, uint8 BitsPerCell)
+    {
+        return static_cast<int32>((static_cast<int64>(NumCells) * BitsPerCell + 7) / 8);
+    }
+}
+
+void FWFCGridFile::Write(const FWFCGridData& Grid, bool bCompress, TArray<uint8>& OutBytes)
+{
+    const int32 NumCells = Grid.States.Num();
+    uint8 BitsPerCell = GetBitsPerCell(Grid.NumTiles);
+
+    // Pack the indices least significant bit first
+    TArray<uint8> Packed;
+    Packed.SetNumZeroed(GetPackedSize(NumCells, BitsPerCell));
+    for (int32 i = 0; i < NumCells; ++i)
+    {
+        const uint32 Value = static_cast<uint32>(FMath::Clamp(Grid.States[i], -1, Grid.NumTiles - 1) + 1);
+        int64 Bit = static_cast<int64>(i) * BitsPerCell;
+
+        for (int32 Written = 0; Written < BitsPerCell;)
+        {
+            const int32 Shift = static_cast<int32>(Bit & 7);
+            const int32 Count = FMath::Min(8 - Shift, BitsPerCell - Written);
+            Packed[Bit >> 3] |= static_cast<uint8>(((Value >> Written) & ((1u << Count) - 1)) << Shift);
+            Written += Count;
+            Bit += Count;
+        }
+    }
+
+    uint16 Flags = 0;
+    TArray<uint8> Compressed;
+    if (bCompress && Packed.Num() > 0)
+    {
+        int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, Packed.Num());
+        Compressed.SetNumUninitialized(CompressedSize);
+
+        // Keep the raw stream if compression doesn't pay off, e.g. for very noisy grids
+        if (FCompression::CompressMemory(NAME_Zlib, Compressed.GetData(), CompressedSize, Packed.GetData(), Packed.Num()) && CompressedSize < Packed.Num())
+        {
+            Compressed.SetNum(CompressedSize);
+            Flags |= GridFileCompressed;
+        }
+    }
+
+    uint32 Magic = GridFileMagic;
+    uint16 Version = GridFileVersion;
+    int32 Width = Grid.Width;
+    int32 Height = Grid.Height;
+    int32 Depth = Grid.Depth;
+    int32 NumTiles = Grid.NumTiles;
+    int32 Seed = Grid.Seed;
+    uint64 RuleHash = Grid.RuleHash;
+    int32 PackedSize = Packed.Num();
+
+    OutBytes.Reset();
+    FMemoryWriter Writer(OutBytes);
+    Writer << Magic << Version << Flags << Width << Height << Depth << NumTiles << Seed << RuleHash << BitsPerCell << PackedSize;
+
+    TArray<uint8>& Payload = (Flags & GridFileCompressed) ? Compressed : Packed;
+    Writer.Serialize(Payload.GetData(), Payload.Num());
+}
+
+bool FWFCGridFile::Read(TArrayView<const uint8> Bytes, FWFCGridData& OutGrid)
+{
+    FMemoryReaderView Reader(Bytes);
+
+    uint32 Magic = 0;
+    uint16 Version = 0;
+    uint16 Flags = 0;
+    int32 Width = 0;
+    int32 Height = 0;
+    int32 Depth = 1;
+    int32 NumTiles = 0;
+    int32 Seed = 0;
+    uint64 RuleHash = 0;
+    uint8 BitsPerCell = 0;
+    int32 PackedSize = 0;
+    Reader << Magic << Version << Flags << Width << Height;
+
+    if (Reader.IsError() || Magic != GridFileMagic || (Version != GridFileVersion && Version != GridFileFlatVersion))
+        return false;
+
+    if (Version != GridFileFlatVersion)
+    {
+        Reader << Depth;
+    }
+    Reader << NumTiles << Seed << RuleHash << BitsPerCell << PackedSize;
+
+    if (Reader.IsError() || Width <= 0 || Height <= 0 || Depth <= 0 || NumTiles < 0 || static_cast<int64>(Width) * Height * Depth > MAX_int32)
+        return false;
+
+    const int32 NumCells = Width * Height * Depth;
+    if (BitsPerCell != GetBitsPerCell(NumTiles) || PackedSize != GetPackedSize(NumCells, BitsPerCell))
+        return false;
+
+    const uint8* Payload = Bytes.GetData() + Reader.Tell();
+    const int64 PayloadSize = Bytes.Num() - Reader.Tell();
+
+    TArray<uint8> Uncompressed;
+    const uint8* Packed = Payload;
+    if (Flags & GridFileCompressed)
+    {
+        Uncompressed.SetNumUninitialized(PackedSize);
+        if (!FCompression::UncompressMemory(NAME_Zlib, Uncompressed.GetData(), PackedSize, Payload, static_cast<int32>(PayloadSize)))
+            return false;
+
+        Packed = Uncompressed.GetData();
+    }
+    else if (PayloadSize < PackedSize)
+    {
+        return false;
+    }
+
+    OutGrid.States.SetNumUninitialized(NumCells);
+    for (int32 i = 0; i < NumCells; ++i)
+    {
+        uint32 Value = 0;
+        int64 Bit = static_cast<int64>(i) * BitsPerCell;
+
+        for (int32 Read = 0; Read < BitsPerCell;)
+        {
+            const int32 Shift = static_cast<int32>(Bit & 7);
+            const int32 Count = FMath::Min(8 - Shift, BitsPerCell - Read);
+            Value |= ((static_cast<uint32>(Packed[Bit >> 3]) >> Shift) & ((1u << Count) - 1)) << Read;
+            Read += Count;
+            Bit += Count;
+        }
+
+        // Padding values past the tile set mean the file is corrupt
+        if (Value > static_cast<uint32>(NumTiles))
+            return false;
+
+        OutGrid.States[i] = static_cast<int32>(Value) - 1;
+    }
+
+    OutGrid.Width = Width;
+    OutGrid.Height = Height;
+    OutGrid.Depth = Depth;
+    OutGrid.NumTiles = NumTiles;
+    OutGrid.Seed = Seed;
+    OutGrid.RuleHash = RuleHash;
+    return true;
+}
+
+bool FWFCGridFile::SaveToFile(const FString& FilePath, const FWFCGridData& Grid, bool bCompress)
+{
+    TArray<uint8> Bytes;
+    Write(Grid, bCompress, Bytes);
+    return FFileHelper::SaveArrayToFile(Bytes, *FilePath);
+}
+
+bool FWFCGridFile::LoadFromFile(const FString& FilePath, FWFCGridData& OutGrid)
+{
+    // Decode straight from the mapped pages so big worlds aren't copied into memory first
+    IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+    TUniquePtr<IMappedFileHandle> MappedFile(PlatformFile.OpenMapped(*FilePath));
+    if (MappedFile)
+    {
+        TUniquePtr<IMappedFileRegion> Region(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+        if (Region)
+            return Read(TArrayView<const uint8>(Region->GetMappedPtr(), Region->GetMappedSize()), OutGrid);
+    }
+
+    TArray<uint8> Bytes;
+    if (!FFileHelper::LoadFileToArray(Bytes, *FilePath, FILEREAD_Silent))
+        return false;
+
+    return Read(Bytes, OutGrid);
+}
+
+void FWFCGridFile::LoadFromFileAsync(const FString& FilePath, TFunction<void(bool bSuccess, FWFCGridData&& Grid)> OnLoaded)
+{
+    UE::Tasks::Launch(UE_SOURCE_LOCATION, [FilePath, OnLoaded = MoveTemp(OnLoaded)]() mutable
+    {
+        FWFCGridData Grid;
+        const bool bSuccess = LoadFromFile(FilePath, Grid);
+
+        AsyncTask(ENamedThreads::GameThread, [bSuccess, Grid = MoveTemp(Grid), OnLoaded = MoveTemp(OnLoaded)]() mutable
+        {
+            OnLoaded(bSuccess, MoveTemp(Grid));
+        });
+    });
+}
@@ -0,0 +1,43 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// A solved grid as stored on disk
+struct FWFCGridData
+{
+    int32 Width = 0;
+    int32 Height = 0;
+    int32 Depth = 1;
+
+    // Size of the tile set the indices refer to
+    int32 NumTiles = 0;
+
+    // Seed and rule hash of the solve that produced the grid
+    int32 Seed = 0;
+    uint64 RuleHash = 0;
+
+    // Tile index of every cell, row by row and layer by layer, -1 where nothing was placed
+    TArray<int32> States;
+};
+
+// Compact binary format for solved grids.
+// A fixed header (magic, version, dimensions, tile count, seed, rule hash) is followed by the
+// tile indices bit-packed with just enough bits for the tile set, optionally zlib compressed.
+struct WFC_API FWFCGridFile
+{
+    // Encode a grid, compressing the index stream when that makes it smaller
+    static void Write(const FWFCGridData& Grid, bool bCompress, TArray<uint8>& OutBytes);
+
+    // Decode a grid; returns false if the data is not a valid grid file
+    static bool Read(TArrayView<const uint8> Bytes, FWFCGridData& OutGrid);
+
+    static bool SaveToFile(const FString& FilePath, const FWFCGridData& Grid, bool bCompress);
+
+    // Read a grid file, memory mapping it when the platform supports it
+    static bool LoadFromFile(const FString& FilePath, FWFCGridData& OutGrid);
+
+    // Read a grid file on a worker thread and hand the result to OnLoaded on the game thread
+    static void LoadFromFileAsync(const FString& FilePath, TFunction<void(bool bSuccess, FWFCGridData&& Grid)> OnLoaded);
+};
@@ -0,0 +1,147 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCOverlappingModel.h"
+#include "Async/ParallelFor.h"
+#include "Hash/CityHash.h"
+#include "Misc/ScopeLock.h"
+
+namespace
+{
+    // Pattern sets by a hash of the sample and the extraction settings
+    struct FPatternCache
+    {
+        FCriticalSection Lock;
+        TMap<uint64, TSharedPtr<const FWFCPatternSet, ESPMode::ThreadSafe>> Entries;
+    };
+
+    FPatternCache& GetPatternCache()
+    {
+        static FPatternCache Cache;
+        return Cache;
+    }
+
+    // Distinct windows in order of first occurrence, with their hashes and counts
+    struct FPatternList
+    {
+        TArray<int32> Values;
+        TArray<uint64> Hashes;
+        TArray<int32> Counts;
+
+        // Hash to index, probing on from the hash when two different windows collide
+        TMap<uint64, int32> Index;
+
+        void Add(const int32* Window, int32 NumValues, uint64 Hash, int32 Count)
+        {
+            for (uint64 Key = Hash;; ++Key)
+            {
+                const int32* Found = Index.Find(Key);
+                if (!Found)
+                {
+                    Index.Add(Key, Counts.Num());
+                    Values.Append(Window, NumValues);
+                    Hashes.Add(Hash);
+                    Counts.Add(Count);
+                    return;
+                }
+
+                if (FMemory::Memcmp(&Values[*Found * NumValues], Window, NumValues * sizeof(int32)) == 0)
+                {
+                    Counts[*Found] += Count;
+                    return;
+                }
+            }
+        }
+    };
+}
+
+void FWFCOverlappingModel::ExtractPatterns(const FWFCSample& Sample, int32 PatternSize, bool bPeriodic, FWFCPatternSet& OutPatterns)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(WFC_ExtractPatterns);
+
+    const int32 N = PatternSize;
+    const int32 NumValues = N * N;
+
+    // Without wrapping, windows have to fit inside the sample
+    const int32 NumX = bPeriodic ? Sample.Width : Sample.Width - N + 1;
+    const int32 NumY = bPeriodic ? Sample.Height : Sample.Height - N + 1;
+
+    OutPatterns.PatternSize = N;
+    OutPatterns.Values.Reset();
+    OutPatterns.Counts.Reset();
+
+    if (N < 1 || NumX < 1 || NumY < 1)
+        return;
+
+    // Every row of windows is deduplicated on its own in parallel...
+    TArray<FPatternList> Rows;
+    Rows.SetNum(NumY);
+
+    ParallelFor(NumY, [&](int32 Y)
+    {
+        FPatternList& Row = Rows[Y];
+        TArray<int32, TInlineAllocator<64>> Window;
+        Window.SetNumUninitialized(NumValues);
+
+        for (int32 X = 0; X < NumX; ++X)
+        {
+            for (int32 DY = 0; DY < N; ++DY)
+            {
+                const int32 SampleY = (Y + DY) % Sample.Height;
+                for (int32 DX = 0; DX < N; ++DX)
+                {
+                    Window[DY * N + DX] = Sample.Values[SampleY * Sample.Width + (X + DX) % Sample.Width];
+                }
+            }
+
+            Row.Add(Window.GetData(), NumValues, HashPattern(Window.GetData(), NumValues), 1);
+        }
+    });
+
+    // ...then merged in row order, so pattern indices don't depend on scheduling
+    FPatternList Merged;
+    for (const FPatternList& Row : Rows)
+    {
+        for (int32 i = 0; i < Row.Counts.Num(); ++i)
+        {
+            Merged.Add(&Row.Values[i * NumValues], NumValues, Row.Hashes[i], Row.Counts[i]);
+        }
+    }
+
+    OutPatterns.Values = MoveTemp(Merged.Values);
+    OutPatterns.Counts = MoveTemp(Merged.Counts);
+}
+
+FWFCOverlappingModel::FPatternsRef FWFCOverlappingModel::GetPatterns(const FWFCSample& Sample, int32 PatternSize, bool bPeriodic)
+{
+    const int32 Settings[] = { Sample.Width, Sample.Height, PatternSize, bPeriodic ? 1 : 0 };
+    uint64 Key = CityHash64(reinterpret_cast<const char*>(Settings), sizeof(Settings));
+    Key = CityHash64WithSeed(reinterpret_cast<const char*>(Sample.Values.GetData()), Sample.Values.Num() * sizeof(int32), Key);
+
+    FPatternCache& Cache = GetPatternCache();
+    {
+        FScopeLock ScopeLock(&Cache.Lock);
+        if (const TSharedPtr<const FWFCPatternSet, ESPMode::ThreadSafe>* Found = Cache.Entries.Find(Key))
+            return Found->ToSharedRef();
+    }
+
+    // Extract outside the lock; two threads asking for the same sample at once just both do the work
+    TSharedRef<FWFCPatternSet, ESPMode::ThreadSafe> Patterns = MakeShared<FWFCPatternSet, ESPMode::ThreadSafe>();
+    ExtractPatterns(Sample, PatternSize, bPeriodic, *Patterns);
+
+    FScopeLock ScopeLock(&Cache.Lock);
+    Cache.Entries.Add(Key, Patterns);
+    return Patterns;
+}
+
+void FWFCOverlappingModel::ClearPatternCache()
+{
+    FPatternCache& Cache = GetPatternCache();
+    FScopeLock ScopeLock(&Cache.Lock);
+    Cache.Entries.Empty();
+}
+
+uint64 FWFCOverlappingModel::HashPattern(const int32* Values, int32 NumValues)
+{
+    return CityHash64(reinterpret_cast<const char*>(Values), NumValues * sizeof(int32));
+}
@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Sample the overlapping model learns from: a grid of tile type indices
+struct WFC_API FWFCSample
+{
+    int32 Width = 0;
+    int32 Height = 0;
+
+    // Row-major tile type index of every sample cell
+    TArray<int32> Values;
+};
+
+// The distinct PatternSize x PatternSize windows of a sample and how often each occurs
+struct WFC_API FWFCPatternSet
+{
+    int32 PatternSize = 0;
+
+    // Row-major values of every pattern, PatternSize * PatternSize each, in order of first occurrence
+    TArray<int32> Values;
+
+    // Number of times each pattern occurs in the sample
+    TArray<int32> Counts;
+
+    int32 GetNumPatterns() const { return Counts.Num(); }
+
+    // Value of a pattern at a position inside its window
+    int32 GetValue(int32 Pattern, int32 X, int32 Y) const
+    {
+        return Values[(Pattern * PatternSize + Y) * PatternSize + X];
+    }
+
+    // Heap memory held by the patterns
+    SIZE_T GetAllocatedSize() const { return Values.GetAllocatedSize() + Counts.GetAllocatedSize(); }
+};
+
+// Pattern extraction for the overlapping model. Each output cell is one pattern and shows the value
+// at its top left; neighboring patterns must agree wherever their windows overlap, which
+// FWFCCompiledRules::CompilePatterns turns into the usual adjacency table.
+class WFC_API FWFCOverlappingModel
+{
+public:
+    typedef TSharedRef<const FWFCPatternSet, ESPMode::ThreadSafe> FPatternsRef;
+
+    // Extract the patterns of a sample, one sample row per task. With bPeriodic the windows wrap around the sample edges.
+    static void ExtractPatterns(const FWFCSample& Sample, int32 PatternSize, bool bPeriodic, FWFCPatternSet& OutPatterns);
+
+    // Patterns of a sample, extracted once per distinct sample and settings and shared afterwards.
+    // Safe to call from any thread.
+    static FPatternsRef GetPatterns(const FWFCSample& Sample, int32 PatternSize, bool bPeriodic);
+
+    // Forget every cached pattern set
+    static void ClearPatternCache();
+
+private:
+    // Hash of a window's values, used to find repeated patterns
+    static uint64 HashPattern(const int32* Values, int32 NumValues);
+};
@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCParallelSolver.h"
+#include "WFCSolverPool.h"
+#include "Async/ParallelFor.h"
+
+EWFCSolveStatus FWFCParallelSolver::Solve(FWFCSolver& SeamSolver, FWFCSolver::FRulesRef Rules, const FWFCSolverSettings& Settings, const std::atomic<bool>* bCancelled) const
+{
+    const int32 Width = Settings.Width;
+    const int32 Height = Settings.Height;
+    const int32 InteriorSize = RegionSize - SeamWidth;
+
+    const int32 NumRegionsX = FMath::DivideAndRoundUp(Width, FMath::Max(RegionSize, 1));
+    const int32 NumRegionsY = FMath::DivideAndRoundUp(Height, FMath::Max(RegionSize, 1));
+    const int32 NumRegions = NumRegionsX * NumRegionsY;
+
+    // Nothing to split; solve the grid in one piece
+    if (InteriorSize < 1 || NumRegions <= 1)
+    {
+        SeamSolver.Init(Rules, Settings);
+        return SeamSolver.Run(bCancelled);
+    }
+
+    // Solve the region interiors independently
+    TArray<TArray<int32>> RegionStates;
+    RegionStates.SetNum(NumRegions);
+
+    ParallelFor(NumRegions, [&](int32 Region)
+    {
+        if (bCancelled && bCancelled->load(std::memory_order_relaxed))
+            return;
+
+        const int32 RegionX = Region % NumRegionsX;
+        const int32 RegionY = Region / NumRegionsX;
+
+        // Regions on the last column or row end at the grid border and need no seam
+        FWFCSolverSettings RegionSettings = Settings;
+        RegionSettings.Width = RegionX == NumRegionsX - 1 ? Width - RegionX * RegionSize : InteriorSize;
+        RegionSettings.Height = RegionY == NumRegionsY - 1 ? Height - RegionY * RegionSize : InteriorSize;
+        RegionSettings.MaxIterations = 0;
+
+        // Each region draws from its own stream so the result doesn't depend on scheduling
+        RegionSettings.Seed = FWFCSolver::DeriveSeed(Settings.Seed, Region);
+
+        // Regions only see the initial constraints that fall inside them
+        if (Settings.Constraints)
+        {
+            TSharedRef<FWFCInitialConstraints, ESPMode::ThreadSafe> RegionConstraints = MakeShared<FWFCInitialConstraints, ESPMode::ThreadSafe>();
+            const FIntVector Origin(RegionX * RegionSize, RegionY * RegionSize, 0);
+            Settings.Constraints->ExtractBox(Width, Height, Origin, FIntVector(RegionSettings.Width, RegionSettings.Height, FMath::Max(Settings.Depth, 1)), *RegionConstraints);
+            RegionSettings.Constraints = RegionConstraints;
+        }
+
+        // Region solvers come from the pool, so repeated solves reuse their buffers
+        FWFCSolverPool::FScopedSolver RegionSolver;
+        RegionSolver->Init(Rules, RegionSettings);
+        RegionSolver->Run(bCancelled);
+        RegionSolver->GetFinalStates(RegionStates[Region]);
+    });
+
+    if (bCancelled && bCancelled->load(std::memory_order_relaxed))
+        return EWFCSolveStatus::Cancelled;
+
+    // Fix every solved interior cell in the full grid and propagate them together
+    SeamSolver.Init(Rules, Settings);
+
+    TArray<uint64, TInlineAllocator<4>> StateMask;
+    StateMask.AddZeroed(Rules->GetNumWords());
+
+    for (int32 Region = 0; Region < NumRegions; ++Region)
+    {
+        const int32 OriginX = (Region % NumRegionsX) * RegionSize;
+        const int32 OriginY = (Region / NumRegionsX) * RegionSize;
+        const int32 RegionWidth = (Region % NumRegionsX) == NumRegionsX - 1 ? Width - OriginX : InteriorSize;
+        const int32 RegionHeight = (Region / NumRegionsX) == NumRegionsY - 1 ? Height - OriginY : InteriorSize;
+        const TArray<int32>& States = RegionStates[Region];
+
+        for (int32 i = 0; i < States.Num(); ++i)
+        {
+            if (States[i] < 0)
+                continue;
+
+            WFCBits::Set(StateMask.GetData(), States[i]);
+            // Not kept on restart, so a contradiction in a seam can also re-solve the interior cells next to it.
+            // Regions are columns through every layer of the grid.
+            const int32 X = OriginX + i % RegionWidth;
+            const int32 Y = OriginY + (i / RegionWidth) % RegionHeight;
+            const int32 Z = i / (RegionWidth * RegionHeight);
+            SeamSolver.ConstrainCell(SeamSolver.XYZToIndex(X, Y, Z), StateMask.GetData(), false);
+            WFCBits::Clear(StateMask.GetData(), States[i]);
+        }
+    }
+
+    SeamSolver.PropagatePendingConstraints();
+
+    // Only seam cells are left to observe
+    return SeamSolver.Run(bCancelled);
+}
@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WFCSolver.h"
+
+// Solves a large grid on several worker threads.
+// The grid is cut into RegionSize x RegionSize blocks, each spanning every layer. The interior of every block, leaving
+// a seam of SeamWidth cells on its east and south sides, is solved on its own in parallel.
+// Seams keep the interiors from touching, so they can't conflict with each other.
+// A final solver over the whole grid then fixes all interior cells in one batched
+// propagation and only has to observe the seam cells.
+struct WFC_API FWFCParallelSolver
+{
+    // Side length of a region including its seam
+    int32 RegionSize = 64;
+
+    // Width of the strip left between neighboring regions
+    int32 SeamWidth = 2;
+
+    // Solve the grid described by Settings. SeamSolver ends up holding the wave of the whole grid.
+    EWFCSolveStatus Solve(FWFCSolver& SeamSolver, FWFCSolver::FRulesRef Rules, const FWFCSolverSettings& Settings, const std::atomic<bool>* bCancelled = nullptr) const;
+};
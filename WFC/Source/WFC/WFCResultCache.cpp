@@ -0,0 +1,167 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCResultCache.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+FWFCResultCache& FWFCResultCache::Get()
+{
+    static FWFCResultCache Instance;
+    return Instance;
+}
+
+void FWFCResultCache::SetLimits(const FLimits& InLimits)
+{
+    FScopeLock ScopeLock(&Lock);
+    Limits = InLimits;
+    EvictEntries();
+}
+
+FWFCResultCache::FLimits FWFCResultCache::GetLimits() const
+{
+    FScopeLock ScopeLock(&Lock);
+    return Limits;
+}
+
+bool FWFCResultCache::Find(uint64 Key, FWFCGridData& OutGrid, bool bUseDisk)
+{
+    {
+        FScopeLock ScopeLock(&Lock);
+        if (FEntry* Entry = Entries.Find(Key))
+        {
+            Entry->LastUse = ++NumUses;
+            return FWFCGridFile::Read(Entry->Data, OutGrid);
+        }
+    }
+
+    if (!bUseDisk)
+        return false;
+
+    const FString Path = GetEntryPath(Key);
+    TArray<uint8> Data;
+    if (!FFileHelper::LoadFileToArray(Data, *Path, FILEREAD_Silent) || !FWFCGridFile::Read(Data, OutGrid))
+        return false;
+
+    // Files are pruned oldest first, so a file that is still read stays
+    IFileManager::Get().SetTimeStamp(*Path, FDateTime::UtcNow());
+
+    // Keep it in memory for the next lookup
+    FScopeLock ScopeLock(&Lock);
+    AddEntry(Key, MoveTemp(Data));
+    return true;
+}
+
+void FWFCResultCache::Store(uint64 Key, const FWFCGridData& Grid, bool bUseDisk)
+{
+    TArray<uint8> Data;
+    FWFCGridFile::Write(Grid, true, Data);
+
+    if (bUseDisk)
+    {
+        if (FFileHelper::SaveArrayToFile(Data, *GetEntryPath(Key)))
+        {
+            PruneDisk(GetLimits());
+        }
+        else
+        {
+            UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse could not write cache entry %s"), *GetEntryPath(Key));
+        }
+    }
+
+    FScopeLock ScopeLock(&Lock);
+    AddEntry(Key, MoveTemp(Data));
+}
+
+void FWFCResultCache::Clear(bool bIncludeDisk)
+{
+    {
+        FScopeLock ScopeLock(&Lock);
+        Entries.Empty();
+        MemoryBytes = 0;
+    }
+
+    if (bIncludeDisk)
+    {
+        IFileManager::Get().DeleteDirectory(*GetCacheDirectory(), false, true);
+    }
+}
+
+FString FWFCResultCache::GetCacheDirectory()
+{
+    return FPaths::ProjectSavedDir() / TEXT("WFCCache");
+}
+
+FString FWFCResultCache::GetEntryPath(uint64 Key)
+{
+    return GetCacheDirectory() / FString::Printf(TEXT("%016llx.wfc"), Key);
+}
+
+void FWFCResultCache::AddEntry(uint64 Key, TArray<uint8>&& Data)
+{
+    FEntry& Entry = Entries.FindOrAdd(Key);
+    MemoryBytes += Data.Num() - Entry.Data.Num();
+    Entry.Data = MoveTemp(Data);
+    Entry.LastUse = ++NumUses;
+    EvictEntries();
+}
+
+void FWFCResultCache::EvictEntries()
+{
+    // The cache holds few entries, so the least recently used one is found by a linear scan
+    while (Entries.Num() > 0 && (Entries.Num() > Limits.MaxEntries || MemoryBytes > Limits.MaxMemoryBytes))
+    {
+        uint64 OldestKey = 0;
+        uint64 OldestUse = MAX_uint64;
+        for (const TPair<uint64, FEntry>& Pair : Entries)
+        {
+            if (Pair.Value.LastUse < OldestUse)
+            {
+                OldestKey = Pair.Key;
+                OldestUse = Pair.Value.LastUse;
+            }
+        }
+
+        MemoryBytes -= Entries.FindChecked(OldestKey).Data.Num();
+        Entries.Remove(OldestKey);
+    }
+}
+
+void FWFCResultCache::PruneDisk(const FLimits& DiskLimits)
+{
+    struct FFileEntry
+    {
+        FString Path;
+        FDateTime Time;
+        int64 Size;
+    };
+
+    TArray<FFileEntry> Files;
+    int64 TotalSize = 0;
+    IFileManager::Get().IterateDirectoryStat(*GetCacheDirectory(), [&Files, &TotalSize](const TCHAR* Path, const FFileStatData& Stat)
+    {
+        if (!Stat.bIsDirectory && FPaths::GetExtension(Path) == TEXT("wfc"))
+        {
+            Files.Add({ Path, Stat.ModificationTime, Stat.FileSize });
+            TotalSize += Stat.FileSize;
+        }
+        return true;
+    });
+
+    // Oldest first, so once a file is young enough and the rest fit, every later one stays too
+    Files.Sort([](const FFileEntry& A, const FFileEntry& B) { return A.Time < B.Time; });
+
+    const FDateTime Now = FDateTime::UtcNow();
+    for (const FFileEntry& File : Files)
+    {
+        if (TotalSize <= DiskLimits.MaxDiskBytes && Now - File.Time <= DiskLimits.MaxDiskAge)
+            break;
+
+        if (IFileManager::Get().Delete(*File.Path, false, false, true))
+        {
+            TotalSize -= File.Size;
+        }
+    }
+}
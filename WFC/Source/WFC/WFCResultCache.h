@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WFCGridFile.h"
+
+// Process-wide store of solved grids, keyed by a hash of everything that determines the result.
+// Entries are kept in memory and, optionally, written to Saved/WFCCache so they survive restarts,
+// both in the compressed grid file format. Both stores are bounded: the least recently used entries
+// are dropped from memory beyond the limits, and the oldest files are deleted from disk.
+// Safe to use from any thread.
+class WFC_API FWFCResultCache
+{
+public:
+    // Bounds of the two stores
+    struct FLimits
+    {
+        // Entries and encoded bytes kept in memory
+        int32 MaxEntries = 64;
+        int64 MaxMemoryBytes = 64ll * 1024 * 1024;
+
+        // Bytes kept on disk, and the age after a file was last written or read at which it is deleted
+        int64 MaxDiskBytes = 512ll * 1024 * 1024;
+        FTimespan MaxDiskAge = FTimespan::FromDays(30.0);
+    };
+
+    static FWFCResultCache& Get();
+
+    // Change the bounds; entries beyond the new memory limits are dropped right away
+    void SetLimits(const FLimits& InLimits);
+    FLimits GetLimits() const;
+
+    // Look up a grid, checking memory first and then disk when bUseDisk is set
+    bool Find(uint64 Key, FWFCGridData& OutGrid, bool bUseDisk);
+
+    // Remember a fully solved grid
+    void Store(uint64 Key, const FWFCGridData& Grid, bool bUseDisk);
+
+    // Forget every entry in memory, and on disk too when bIncludeDisk is set
+    void Clear(bool bIncludeDisk);
+
+    // Directory holding the entries written to disk
+    static FString GetCacheDirectory();
+
+private:
+    struct FEntry
+    {
+        TArray<uint8> Data;
+
+        // Value of NumUses when the entry was last stored or found
+        uint64 LastUse = 0;
+    };
+
+    // Path of the file holding an entry
+    static FString GetEntryPath(uint64 Key);
+
+    // Keep an encoded grid in memory, then drop the least recently used entries beyond the limits. Needs Lock.
+    void AddEntry(uint64 Key, TArray<uint8>&& Data);
+    void EvictEntries();
+
+    // Delete the files older than MaxDiskAge, then the oldest ones until the rest fit in MaxDiskBytes
+    void PruneDisk(const FLimits& DiskLimits);
+
+    mutable FCriticalSection Lock;
+
+    // Encoded grids by key
+    TMap<uint64, FEntry> Entries;
+
+    // Encoded bytes of every entry
+    int64 MemoryBytes = 0;
+
+    // Lookups and stores so far, to order entries by last use
+    uint64 NumUses = 0;
+
+    FLimits Limits;
+};
@@ -0,0 +1,260 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCRules.h"
+#include "WFCWave.h"
+#include "WFCOverlappingModel.h"
+#include "Async/ParallelFor.h"
+#include "Hash/CityHash.h"
+
+void FWFCCompiledRules::Compile(const TArray<FTileType>& TileTypes, const FWFCEdgeMatrix& Edges)
+{
+    MakeVariants(TileTypes, Variants);
+
+    NumTiles = Variants.Num();
+    NumWords = FMath::DivideAndRoundUp(NumTiles, 64);
+
+    AdjacencyMasks.Reset();
+    AdjacencyMasks.SetNumZeroed(NumTiles * NumDirections * NumWords);
+
+    // Variants split the weight of their tile type, so enabling symmetry doesn't make a tile type more common
+    TArray<int32> NumVariants;
+    NumVariants.SetNumZeroed(TileTypes.Num());
+    for (const FWFCTileVariant& Variant : Variants)
+    {
+        ++NumVariants[Variant.SourceTile];
+    }
+
+    Weights.SetNumUninitialized(NumTiles);
+    WeightLogWeights.SetNumUninitialized(NumTiles);
+    for (int32 Tile = 0; Tile < NumTiles; ++Tile)
+    {
+        const int32 SourceTile = Variants[Tile].SourceTile;
+
+        // A zero weight would make the entropy undefined, so such tiles are just very unlikely
+        const double Weight = FMath::Max<double>(TileTypes[SourceTile].Weight / NumVariants[SourceTile], UE_KINDA_SMALL_NUMBER);
+        Weights[Tile] = Weight;
+        WeightLogWeights[Tile] = Weight * FMath::Loge(Weight);
+    }
+
+    // Bitset of the tiles showing each edge type on each side
+    const int32 NumEdgeTypes = FWFCEdgeMatrix::NumEdgeTypes;
+    TArray<uint64> TilesWithEdge;
+    TilesWithEdge.SetNumZeroed(NumDirections * NumEdgeTypes * NumWords);
+
+    for (int32 Tile = 0; Tile < NumTiles; ++Tile)
+    {
+        for (int32 Dir = 0; Dir < NumDirections; ++Dir)
+        {
+            const int32 Edge = static_cast<int32>(Variants[Tile].Edges[Dir]);
+            TilesWithEdge[(Dir * NumEdgeTypes + Edge) * NumWords + (Tile >> 6)] |= 1ull << (Tile & 63);
+        }
+    }
+
+    // Each mask is the union of the tiles showing a compatible edge, so compiling costs T x E words instead of T x T edge tests
+    for (int32 Tile = 0; Tile < NumTiles; ++Tile)
+    {
+        for (int32 Dir = 0; Dir < NumDirections; ++Dir)
+        {
+            const EWFCDirection Direction = static_cast<EWFCDirection>(Dir);
+
+            // The neighbor touches this tile with its opposite edge
+            const uint64 CompatibleEdges = Edges.GetRow(Variants[Tile].Edges[Dir]);
+            const int32 Opposite = static_cast<int32>(GetOppositeDirection(Direction));
+
+            uint64* Mask = &AdjacencyMasks[(Tile * NumDirections + Dir) * NumWords];
+
+            WFCBits::ForEachSetBit(&CompatibleEdges, 1, [&](int32 Other)
+            {
+                const uint64* Tiles = &TilesWithEdge[(Opposite * NumEdgeTypes + Other) * NumWords];
+                for (int32 Word = 0; Word < NumWords; ++Word)
+                {
+                    Mask[Word] |= Tiles[Word];
+                }
+            });
+        }
+    }
+
+    ComputeHash();
+}
+
+void FWFCCompiledRules::CompilePatterns(const FWFCPatternSet& Patterns)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(WFC_CompilePatterns);
+
+    const int32 N = Patterns.PatternSize;
+    NumTiles = Patterns.GetNumPatterns();
+    NumWords = FMath::DivideAndRoundUp(NumTiles, 64);
+
+    AdjacencyMasks.Reset();
+    AdjacencyMasks.SetNumZeroed(NumTiles * NumDirections * NumWords);
+
+    Variants.SetNum(NumTiles);
+    Weights.SetNumUninitialized(NumTiles);
+    WeightLogWeights.SetNumUninitialized(NumTiles);
+    for (int32 Tile = 0; Tile < NumTiles; ++Tile)
+    {
+        // A cell shows the value at the top left of its pattern
+        Variants[Tile] = FWFCTileVariant();
+        Variants[Tile].SourceTile = Patterns.GetValue(Tile, 0, 0);
+
+        const double Weight = Patterns.Counts[Tile];
+        Weights[Tile] = Weight;
+        WeightLogWeights[Tile] = Weight * FMath::Loge(Weight);
+    }
+
+    // Each pattern only writes its own masks, so the quadratic comparison can be split across threads
+    ParallelFor(NumTiles, [&](int32 Tile)
+    {
+        for (int32 Dir = NumHorizontalDirections; Dir < NumDirections; ++Dir)
+        {
+            uint64* Mask = &AdjacencyMasks[(Tile * NumDirections + Dir) * NumWords];
+            for (int32 Other = 0; Other < NumTiles; ++Other)
+            {
+                WFCBits::Set(Mask, Other);
+            }
+        }
+
+        for (int32 Dir = 0; Dir < NumHorizontalDirections; ++Dir)
+        {
+            const FIntVector Offset = GetOffset(static_cast<EWFCDirection>(Dir));
+            uint64* Mask = &AdjacencyMasks[(Tile * NumDirections + Dir) * NumWords];
+
+            for (int32 Other = 0; Other < NumTiles; ++Other)
+            {
+                // Compare the part of this window that the neighbor's window, shifted by Offset, covers too
+                bool bAgree = true;
+                for (int32 Y = FMath::Max(0, Offset.Y); Y < FMath::Min(N, N + Offset.Y) && bAgree; ++Y)
+                {
+                    for (int32 X = FMath::Max(0, Offset.X); X < FMath::Min(N, N + Offset.X) && bAgree; ++X)
+                    {
+                        bAgree = Patterns.GetValue(Tile, X, Y) == Patterns.GetValue(Other, X - Offset.X, Y - Offset.Y);
+                    }
+                }
+
+                if (bAgree)
+                {
+                    WFCBits::Set(Mask, Other);
+                }
+            }
+        }
+    });
+
+    ComputeHash();
+}
+
+void FWFCCompiledRules::ComputeHash()
+{
+    // The table and weights are all that the solver reads from the tile set.
+    // The variant orientations are hashed too, since solved tile indices refer to them.
+    Hash = CityHash64WithSeed(reinterpret_cast<const char*>(AdjacencyMasks.GetData()), AdjacencyMasks.Num() * sizeof(uint64), NumTiles);
+    Hash = CityHash64WithSeed(reinterpret_cast<const char*>(Weights.GetData()), Weights.Num() * sizeof(double), Hash);
+    for (const FWFCTileVariant& Variant : Variants)
+    {
+        const int32 Orientation[] = { Variant.SourceTile, Variant.Rotation, Variant.bReflected ? 1 : 0 };
+        Hash = CityHash64WithSeed(reinterpret_cast<const char*>(Orientation), sizeof(Orientation), Hash);
+    }
+}
+
+void FWFCCompiledRules::MakeVariants(const TArray<FTileType>& TileTypes, TArray<FWFCTileVariant>& OutVariants)
+{
+    OutVariants.Reset(TileTypes.Num());
+
+    for (int32 SourceTile = 0; SourceTile < TileTypes.Num(); ++SourceTile)
+    {
+        const FTileType& Tile = TileTypes[SourceTile];
+        const int32 FirstVariant = OutVariants.Num();
+        const int32 NumRotations = Tile.bGenerateRotations ? 4 : 1;
+        const int32 NumReflections = Tile.bGenerateReflections ? 2 : 1;
+
+        for (int32 Reflection = 0; Reflection < NumReflections; ++Reflection)
+        {
+            for (int32 Rotation = 0; Rotation < NumRotations; ++Rotation)
+            {
+                FWFCTileVariant Variant;
+                Variant.SourceTile = SourceTile;
+                Variant.Rotation = Rotation;
+                Variant.bReflected = Reflection != 0;
+
+                // Mirroring swaps the east and west edges, then each turn moves every side edge one direction clockwise
+                for (int32 Dir = 0; Dir < NumHorizontalDirections; ++Dir)
+                {
+                    int32 SourceDir = (Dir - Rotation + NumHorizontalDirections) % NumHorizontalDirections;
+                    if (Variant.bReflected && (SourceDir == static_cast<int32>(EWFCDirection::East) || SourceDir == static_cast<int32>(EWFCDirection::West)))
+                    {
+                        SourceDir = static_cast<int32>(GetOppositeDirection(static_cast<EWFCDirection>(SourceDir)));
+                    }
+                    Variant.Edges[Dir] = GetEdge(Tile, static_cast<EWFCDirection>(SourceDir));
+                }
+
+                // Turning around the vertical axis keeps the top and bottom faces where they are
+                Variant.Edges[static_cast<int32>(EWFCDirection::Up)] = Tile.UpEdge;
+                Variant.Edges[static_cast<int32>(EWFCDirection::Down)] = Tile.DownEdge;
+
+                // A variant with the same edges as another of this tile type adds nothing for the solver
+                bool bDuplicate = false;
+                for (int32 Other = FirstVariant; Other < OutVariants.Num() && !bDuplicate; ++Other)
+                {
+                    bDuplicate = FMemory::Memcmp(OutVariants[Other].Edges, Variant.Edges, sizeof(Variant.Edges)) == 0;
+                }
+
+                if (!bDuplicate)
+                {
+                    OutVariants.Add(Variant);
+                }
+            }
+        }
+    }
+}
+
+void FWFCCompiledRules::Reset()
+{
+    NumTiles = 0;
+    NumWords = 0;
+    Hash = 0;
+    Variants.Empty();
+    AdjacencyMasks.Empty();
+    Weights.Empty();
+    WeightLogWeights.Empty();
+}
+
+EWFCDirection FWFCCompiledRules::GetOppositeDirection(EWFCDirection Direction)
+{
+    switch (Direction)
+    {
+    case EWFCDirection::North: return EWFCDirection::South;
+    case EWFCDirection::East:  return EWFCDirection::West;
+    case EWFCDirection::South: return EWFCDirection::North;
+    case EWFCDirection::West:  return EWFCDirection::East;
+    case EWFCDirection::Up:    return EWFCDirection::Down;
+    case EWFCDirection::Down:  return EWFCDirection::Up;
+    default:                   return Direction;
+    }
+}
+
+FIntVector FWFCCompiledRules::GetOffset(EWFCDirection Direction)
+{
+    switch (Direction)
+    {
+    case EWFCDirection::North: return FIntVector(0, -1, 0);
+    case EWFCDirection::East:  return FIntVector(1, 0, 0);
+    case EWFCDirection::South: return FIntVector(0, 1, 0);
+    case EWFCDirection::West:  return FIntVector(-1, 0, 0);
+    case EWFCDirection::Up:    return FIntVector(0, 0, 1);
+    case EWFCDirection::Down:  return FIntVector(0, 0, -1);
+    default:                   return FIntVector::ZeroValue;
+    }
+}
+
+ETileEdgeType FWFCCompiledRules::GetEdge(const FTileType& Tile, EWFCDirection Direction)
+{
+    switch (Direction)
+    {
+    case EWFCDirection::North: return Tile.NorthEdge;
+    case EWFCDirection::East:  return Tile.EastEdge;
+    case EWFCDirection::South: return Tile.SouthEdge;
+    case EWFCDirection::Up:    return Tile.UpEdge;
+    case EWFCDirection::Down:  return Tile.DownEdge;
+    default:                   return Tile.WestEdge;
+    }
+}
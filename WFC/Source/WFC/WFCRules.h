@@ -0,0 +1,142 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WFCTypes.h"
+
+struct FWFCPatternSet;
+
+// Directions used to index the compiled adjacency table: the four cardinal ones, then the layers above and below
+enum class EWFCDirection : uint8
+{
+    North,
+    East,
+    South,
+    West,
+    Up,
+    Down,
+    Count
+};
+
+// Compatibility relation between edge types as one bit row per edge type
+struct WFC_API FWFCEdgeMatrix
+{
+    static constexpr int32 NumEdgeTypes = static_cast<int32>(ETileEdgeType::Type_D) + 1;
+    static_assert(NumEdgeTypes <= 64, "Each row of the edge matrix is a single 64-bit word");
+
+    // Let Edge connect to Other; the reverse has to be allowed separately
+    void Allow(ETileEdgeType Edge, ETileEdgeType Other)
+    {
+        Rows[static_cast<int32>(Edge)] |= 1ull << static_cast<int32>(Other);
+    }
+
+    bool IsCompatible(ETileEdgeType Edge, ETileEdgeType Other) const
+    {
+        return (Rows[static_cast<int32>(Edge)] >> static_cast<int32>(Other)) & 1;
+    }
+
+    // Bitset of the edge types Edge can connect to
+    uint64 GetRow(ETileEdgeType Edge) const { return Rows[static_cast<int32>(Edge)]; }
+
+private:
+    uint64 Rows[NumEdgeTypes] = {};
+};
+
+// One orientation of an authored tile type; the solver works on these
+struct FWFCTileVariant
+{
+    // Index of the tile type in the authored tile set
+    int32 SourceTile = 0;
+
+    // Quarter turns, each a yaw of 90 degrees that moves the east edge to the south
+    int32 Rotation = 0;
+
+    // Mirrored from east to west before turning
+    bool bReflected = false;
+
+    // Edges of the variant, indexed by EWFCDirection
+    ETileEdgeType Edges[static_cast<int32>(EWFCDirection::Count)] = {};
+
+    // Transform placing the variant's mesh at Location
+    FTransform MakeTransform(const FVector& Location) const
+    {
+        return FTransform(FRotator(0.f, 90.f * Rotation, 0.f), Location, FVector(bReflected ? -1.f : 1.f, 1.f, 1.f));
+    }
+};
+
+// Adjacency rules compiled from a tile set.
+// For each tile and direction a bitset holds the tiles that are allowed next to it,
+// so propagation only has to OR and AND words instead of comparing edges.
+struct WFC_API FWFCCompiledRules
+{
+    static constexpr int32 NumDirections = static_cast<int32>(EWFCDirection::Count);
+
+    // Directions turned by rotations and reflections, which leave Up and Down in place
+    static constexpr int32 NumHorizontalDirections = static_cast<int32>(EWFCDirection::Up);
+
+    // Build the adjacency table from the tile edges and the edge types each edge can connect to.
+    // Tile types with symmetry enabled are expanded into their variants first.
+    void Compile(const TArray<FTileType>& TileTypes, const FWFCEdgeMatrix& Edges);
+
+    // Expand every tile type into its distinct rotations and reflections, in tile type order.
+    // Types without symmetry keep one variant, so their tile index stays the tile type index.
+    static void MakeVariants(const TArray<FTileType>& TileTypes, TArray<FWFCTileVariant>& OutVariants);
+
+    // Build the table of an overlapping model, with one tile per pattern. Two patterns may be neighbors
+    // if their windows agree where they overlap; weights are the pattern counts, and each pattern's
+    // variant refers to the tile type at its top left. Patterns are flat, so they allow any pattern above and below.
+    void CompilePatterns(const FWFCPatternSet& Patterns);
+
+    // Drop the compiled table
+    void Reset();
+
+    // Number of tiles the rules were compiled for, counting every variant
+    int32 GetNumTiles() const { return NumTiles; }
+
+    // Tile type and orientation of a compiled tile
+    const FWFCTileVariant& GetVariant(int32 Tile) const { return Variants[Tile]; }
+
+    // Number of 64-bit words in each tile bitset
+    int32 GetNumWords() const { return NumWords; }
+
+    // Bitset of the tiles allowed next to Tile in the given direction
+    const uint64* GetAllowedNeighbors(int32 Tile, EWFCDirection Direction) const
+    {
+        return &AdjacencyMasks[(Tile * NumDirections + static_cast<int32>(Direction)) * NumWords];
+    }
+
+    // Hash of the adjacency table and weights; equal hashes solve to equal grids for the same settings
+    uint64 GetHash() const { return Hash; }
+
+    // Observation weight of a tile, and that weight times its logarithm.
+    // The weight of a tile type is shared out between its variants.
+    double GetWeight(int32 Tile) const { return Weights[Tile]; }
+    double GetWeightLogWeight(int32 Tile) const { return WeightLogWeights[Tile]; }
+
+    // Get the direction pointing back from a neighbor
+    static EWFCDirection GetOppositeDirection(EWFCDirection Direction);
+
+    // Grid offset of the neighbor in a direction; north is towards -Y and up towards +Z
+    static FIntVector GetOffset(EWFCDirection Direction);
+
+    // Get the edge type of a tile in a direction
+    static ETileEdgeType GetEdge(const FTileType& Tile, EWFCDirection Direction);
+
+private:
+    // Hash the compiled table, weights and variants
+    void ComputeHash();
+
+    int32 NumTiles = 0;
+    int32 NumWords = 0;
+    uint64 Hash = 0;
+
+    TArray<FWFCTileVariant> Variants;
+
+    // Tile-major table of NumTiles * NumDirections bitsets, NumWords each
+    TArray<uint64> AdjacencyMasks;
+
+    // Per tile terms of the Shannon entropy of a cell
+    TArray<double> Weights;
+    TArray<double> WeightLogWeights;
+};
@@ -0,0 +1,1032 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCSolver.h"
+#include "WFCStats.h"
+
+namespace
+{
+    // Upper bound of the tiebreak noise, well below the entropy difference of one ban
+    constexpr float MaxEntropyNoise = 1e-4f;
+
+    float ComputeEntropy(double SumWeights, double SumWeightLogWeights)
+    {
+        return static_cast<float>(FMath::Loge(SumWeights) - SumWeightLogWeights / SumWeights);
+    }
+
+    // Side length of the bricks cells are stored in
+    constexpr int32 BrickSize = 4;
+}
+
+void FWFCSolver::Init(FRulesRef InRules, const FWFCSolverSettings& InSettings)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(WFC_SolverInit);
+    SCOPE_CYCLE_COUNTER(STAT_WFC_SolverInit);
+
+    Rules = InRules;
+    Settings = InSettings;
+    Settings.Depth = FMath::Max(Settings.Depth, 1);
+    NumActiveDirections = Settings.Depth > 1 ? FWFCCompiledRules::NumDirections : FWFCCompiledRules::NumHorizontalDirections;
+
+    const int32 NumCells = Settings.Width * Settings.Height * Settings.Depth;
+    const int32 NumTiles = Rules->GetNumTiles();
+
+    BuildLayout();
+
+    // Initialize grid, with all cells having all possible states
+    Wave.Init(NumCells, NumTiles);
+
+    RandomStream.Initialize(Settings.Seed);
+
+    // Every cell starts with the weights of the whole tile set
+    double TotalWeight = 0.0;
+    double TotalWeightLogWeight = 0.0;
+    for (int32 Tile = 0; Tile < NumTiles; ++Tile)
+    {
+        TotalWeight += Rules->GetWeight(Tile);
+        TotalWeightLogWeight += Rules->GetWeightLogWeight(Tile);
+    }
+
+    // Per cell buffers only grow, so solving the same size of grid again reuses them
+    SumWeights.SetNumUninitialized(NumCells, EAllowShrinking::No);
+    SumWeightLogWeights.SetNumUninitialized(NumCells, EAllowShrinking::No);
+    EntropyNoise.SetNumUninitialized(NumCells, EAllowShrinking::No);
+    for (int32 i = 0; i < NumCells; ++i)
+    {
+        SumWeights[i] = TotalWeight;
+        SumWeightLogWeights[i] = TotalWeightLogWeight;
+        EntropyNoise[i] = RandomStream.FRand() * MaxEntropyNoise;
+    }
+
+    const int32 NumWords = Rules->GetNumWords();
+    NeighborMask.SetNumUninitialized(NumWords, EAllowShrinking::No);
+    RemovedMask.SetNumUninitialized(NumWords, EAllowShrinking::No);
+    ChosenMask.SetNumUninitialized(NumWords, EAllowShrinking::No);
+
+    // Every cell starts uncollapsed unless there is only one tile type.
+    // The index is sized for every cell either way, since a local restart can put cells back in it.
+    EntropyIndex.Init(ComputeEntropy(TotalWeight, TotalWeightLogWeight), EntropyNoise);
+    for (int32 i = NumCells - 1; NumTiles == 1 && i >= 0; --i)
+    {
+        EntropyIndex.Remove(i);
+    }
+
+    // Only keep an undo trail when contradictions can be backtracked
+    bRecordTrail = Settings.BacktrackDepth > 0 && Settings.MaxBacktracks > 0;
+    Trail.Reset();
+    Decisions.Reset();
+    SeedMaskOffsets.Reset();
+    SeedMasks.Reset();
+    if (bRecordTrail)
+    {
+        // Decisions never outgrow the backtrack depth; the trail usually stays within a few bans per cell
+        Decisions.Reserve(Settings.BacktrackDepth + 1);
+        Trail.Reserve(NumCells);
+    }
+    ContradictionCell = INDEX_NONE;
+    NumBacktracks = 0;
+    NumLocalRestarts = 0;
+    Stats = FWFCSolverStats();
+
+    // Size the propagation queue once for the whole generation
+    PropagationQueue.Init(NumCells);
+
+    if (Settings.Propagator == EWFCPropagator::SupportCount)
+    {
+        InitSupportCounts();
+    }
+
+    NewlyCollapsed.Reset();
+    if (bRecordCollapses)
+    {
+        NewlyCollapsed.Reserve(NumCells);
+
+        // With a single tile type every cell starts out collapsed
+        for (int32 i = 0; NumTiles == 1 && i < NumCells; ++i)
+        {
+            NewlyCollapsed.Add(i);
+        }
+    }
+
+    MaxIterations = Settings.MaxIterations > 0 ? Settings.MaxIterations : NumCells * 10; // Safety limit to prevent infinite loops
+    IterationCount = 0;
+
+    if (Settings.Constraints)
+    {
+        checkf(Settings.Constraints->GetNumWords() == Rules->GetNumWords(), TEXT("Initial constraints were made for another tile set"));
+
+        // Restrict every constrained cell first, then propagate all of them in one pass
+        Settings.Constraints->ForEach([this](int32 Cell, const uint64* Mask)
+        {
+            ConstrainCell(Cell, Mask, true);
+        });
+
+        PropagatePendingConstraints();
+    }
+}
+
+void FWFCSolver::Reset()
+{
+    Rules.Reset();
+    Settings = FWFCSolverSettings();
+    Wave = FWFCWave();
+    StorageIndices.Empty();
+    GridIndices.Empty();
+    Neighbors.Empty();
+    EntropyIndex = FWFCEntropyIndex();
+    SumWeights.Empty();
+    SumWeightLogWeights.Empty();
+    EntropyNoise.Empty();
+    PropagationQueue = FWFCCellQueue();
+    SupportCounts.Empty();
+    BanStack.Empty();
+    Trail.Empty();
+    Decisions.Empty();
+    SeedMaskOffsets.Empty();
+    SeedMasks.Empty();
+    ContradictionCell = INDEX_NONE;
+    NumBacktracks = 0;
+    NumLocalRestarts = 0;
+    Stats = FWFCSolverStats();
+    NewlyCollapsed.Empty();
+    NeighborMask.Empty();
+    RemovedMask.Empty();
+    ChosenMask.Empty();
+    InitialSupport.Empty();
+    MaxIterations = 0;
+    IterationCount = 0;
+}
+
+void FWFCSolver::Clear()
+{
+    Rules.Reset();
+    Settings = FWFCSolverSettings();
+    Wave.Init(0, 0);
+    StorageIndices.Reset();
+    GridIndices.Reset();
+    Neighbors.Reset();
+    EntropyIndex.Init(0, 0.f);
+    PropagationQueue.Init(0);
+    SumWeights.Reset();
+    SumWeightLogWeights.Reset();
+    EntropyNoise.Reset();
+    SupportCounts.Reset();
+    BanStack.Reset();
+    Trail.Reset();
+    Decisions.Reset();
+    SeedMaskOffsets.Reset();
+    SeedMasks.Reset();
+    ContradictionCell = INDEX_NONE;
+    NumBacktracks = 0;
+    NumLocalRestarts = 0;
+    Stats = FWFCSolverStats();
+    NewlyCollapsed.Reset();
+    MaxIterations = 0;
+    IterationCount = 0;
+}
+
+EWFCSolveStatus FWFCSolver::Step()
+{
+    // Constraints applied before the first step may already have emptied a cell
+    if (HasContradiction() && !ResolveContradiction())
+        return EWFCSolveStatus::Failed;
+
+    if (IsGridFullyCollapsed())
+        return EWFCSolveStatus::Completed;
+
+    if (IterationCount >= MaxIterations)
+        return EWFCSolveStatus::Incomplete;
+
+    // Find the cell with the lowest entropy
+    int32 CellToCollapse = FindCellWithLowestEntropy();
+
+    if (CellToCollapse == -1)
+        return EWFCSolveStatus::Incomplete;  // No valid cells left to collapse
+
+    const int64 BansBefore = Stats.NumBans;
+
+    // Collapse the cell
+    CollapseCell(CellToCollapse);
+
+    // Propagate constraints
+    PropagateConstraints(CellToCollapse);
+
+    IterationCount++;
+
+    const bool bResolved = !HasContradiction() || ResolveContradiction();
+
+    INC_DWORD_STAT(STAT_WFC_Iterations);
+    INC_DWORD_STAT_BY(STAT_WFC_StatesBanned, static_cast<uint32>(Stats.NumBans - BansBefore));
+    SET_DWORD_STAT(STAT_WFC_PeakQueueDepth, Stats.PeakQueueDepth);
+
+    if (!bResolved)
+        return EWFCSolveStatus::Failed;
+
+    return IsGridFullyCollapsed() ? EWFCSolveStatus::Completed : EWFCSolveStatus::Running;
+}
+
+EWFCSolveStatus FWFCSolver::Run(const std::atomic<bool>* bCancelled)
+{
+    // Run the WFC algorithm until the grid is fully collapsed
+    EWFCSolveStatus Status = IsGridFullyCollapsed() ? EWFCSolveStatus::Completed : EWFCSolveStatus::Running;
+
+    while (Status == EWFCSolveStatus::Running)
+    {
+        if (bCancelled && bCancelled->load(std::memory_order_relaxed))
+            return EWFCSolveStatus::Cancelled;
+
+        Status = Step();
+    }
+
+    return Status;
+}
+
+SIZE_T FWFCSolver::GetAllocatedSize() const
+{
+    return Wave.GetAllocatedSize()
+        + StorageIndices.GetAllocatedSize()
+        + GridIndices.GetAllocatedSize()
+        + Neighbors.GetAllocatedSize()
+        + EntropyIndex.GetAllocatedSize()
+        + PropagationQueue.GetAllocatedSize()
+        + SumWeights.GetAllocatedSize()
+        + SumWeightLogWeights.GetAllocatedSize()
+        + EntropyNoise.GetAllocatedSize()
+        + SupportCounts.GetAllocatedSize()
+        + BanStack.GetAllocatedSize()
+        + Trail.GetAllocatedSize()
+        + Decisions.GetAllocatedSize()
+        + SeedMaskOffsets.GetAllocatedSize()
+        + SeedMasks.GetAllocatedSize()
+        + NewlyCollapsed.GetAllocatedSize()
+        + NeighborMask.GetAllocatedSize()
+        + RemovedMask.GetAllocatedSize()
+        + ChosenMask.GetAllocatedSize()
+        + InitialSupport.GetAllocatedSize();
+}
+
+void FWFCSolver::SetRecordCollapses(bool bRecord)
+{
+    bRecordCollapses = bRecord;
+    NewlyCollapsed.Reset();
+}
+
+void FWFCSolver::ConsumeNewlyCollapsed(TArray<int32>& OutCells)
+{
+    Swap(OutCells, NewlyCollapsed);
+    NewlyCollapsed.Reset();
+}
+
+float FWFCSolver::GetProgress() const
+{
+    const int32 NumCells = Wave.GetNumCells();
+    return NumCells > 0 ? static_cast<float>(NumCells - EntropyIndex.Num()) / NumCells : 0.f;
+}
+
+void FWFCSolver::GetFinalStates(TArray<int32>& OutStates) const
+{
+    OutStates.SetNumUninitialized(Wave.GetNumCells());
+    for (int32 i = 0; i < Wave.GetNumCells(); ++i)
+    {
+        OutStates[GridIndices[i]] = Wave.IsCollapsed(i) ? Wave.GetFirstState(i) : -1;
+    }
+}
+
+int32 FWFCSolver::FindCellWithLowestEntropy() const
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(WFC_FindCellWithLowestEntropy);
+    SCOPE_CYCLE_COUNTER(STAT_WFC_FindLowestEntropy);
+
+    // The index keeps uncollapsed cells ordered by the entropy of their weighted states
+    return EntropyIndex.GetLowest();
+}
+
+void FWFCSolver::CollapseCell(int32 CellIndex)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(WFC_CollapseCell);
+    SCOPE_CYCLE_COUNTER(STAT_WFC_CollapseCell);
+
+    if (CellIndex < 0 || CellIndex >= Wave.GetNumCells())
+        return;
+
+    if (Wave.GetCount(CellIndex) <= 1)
+        return;
+
+    // Choose a state with a probability proportional to its weight by walking the prefix sums
+    const double Target = RandomStream.GetFraction() * SumWeights[CellIndex];
+    double Accumulated = 0.0;
+    int32 ChosenState = INDEX_NONE;
+    int32 LastState = INDEX_NONE;
+    WFCBits::ForEachSetBit(Wave.GetRow(CellIndex), Wave.GetNumWords(), [this, Target, &Accumulated, &ChosenState, &LastState](int32 State)
+    {
+        LastState = State;
+        if (ChosenState == INDEX_NONE)
+        {
+            Accumulated += Rules->GetWeight(State);
+            if (Accumulated > Target)
+            {
+                ChosenState = State;
+            }
+        }
+    });
+
+    // Rounding can leave the target just past the last prefix sum
+    if (ChosenState == INDEX_NONE)
+    {
+        ChosenState = LastState;
+    }
+
+    if (bRecordTrail)
+    {
+        // Remember the observation so a contradiction can undo it
+        Decisions.Add({ CellIndex, ChosenState, Trail.Num() });
+        TrimDecisions();
+    }
+
+    if (Settings.Propagator == EWFCPropagator::Bitmask && !bRecordTrail)
+    {
+        // Collapse the cell to this state
+        Stats.NumBans += Wave.GetCount(CellIndex) - 1;
+        Wave.Collapse(CellIndex, ChosenState);
+        SumWeights[CellIndex] = Rules->GetWeight(ChosenState);
+        SumWeightLogWeights[CellIndex] = Rules->GetWeightLogWeight(ChosenState);
+        OnCellStatesChanged(CellIndex);
+        return;
+    }
+
+    // Ban every other state so each removal is propagated and can be undone on its own
+    FMemory::Memzero(ChosenMask.GetData(), ChosenMask.Num() * sizeof(uint64));
+    WFCBits::Set(ChosenMask.GetData(), ChosenState);
+    RestrictCell(CellIndex, ChosenMask.GetData());
+}
+
+void FWFCSolver::PropagateConstraints(int32 CellIndex)
+{
+    if (CellIndex < 0 || CellIndex >= Wave.GetNumCells())
+        return;
+
+    // Seed the propagation queue with the collapsed cell
+    if (Settings.Propagator == EWFCPropagator::Bitmask)
+    {
+        PropagationQueue.Push(CellIndex);
+    }
+
+    PropagatePendingConstraints();
+}
+
+void FWFCSolver::PropagatePendingConstraints()
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(WFC_PropagateConstraints);
+    SCOPE_CYCLE_COUNTER(STAT_WFC_PropagateConstraints);
+
+    if (Settings.Propagator == EWFCPropagator::SupportCount)
+    {
+        PropagateSupportCounts();
+    }
+    else
+    {
+        PropagateBitmask();
+    }
+}
+
+bool FWFCSolver::ConstrainCell(int32 GridIndex, const uint64* AllowedMask, bool bKeepOnRestart)
+{
+    if (GridIndex < 0 || GridIndex >= Wave.GetNumCells())
+        return false;
+
+    const int32 CellIndex = StorageIndices[GridIndex];
+
+    const int32 NewCount = Wave.CountIntersection(CellIndex, AllowedMask);
+
+    if (NewCount == 0)
+        return false;
+
+    if (bKeepOnRestart)
+    {
+        const int32 NumWords = Wave.GetNumWords();
+        if (const int32* Offset = SeedMaskOffsets.Find(CellIndex))
+        {
+            // Several constraints on one cell combine into one mask
+            for (int32 Word = 0; Word < NumWords; ++Word)
+            {
+                SeedMasks[*Offset + Word] &= AllowedMask[Word];
+            }
+        }
+        else
+        {
+            SeedMaskOffsets.Add(CellIndex, SeedMasks.Num());
+            SeedMasks.Append(AllowedMask, NumWords);
+        }
+    }
+
+    if (NewCount == Wave.GetCount(CellIndex))
+        return true;
+
+    RestrictCell(CellIndex, AllowedMask);
+
+    if (Settings.Propagator == EWFCPropagator::Bitmask)
+    {
+        PropagationQueue.Push(CellIndex);
+    }
+
+    return true;
+}
+
+template <typename KernelsType>
+void FWFCSolver::GetAllowedNeighborMask(KernelsType Kernels, int32 CellIndex, EWFCDirection Direction, uint64* OutMask) const
+{
+    const int32 NumWords = Rules->GetNumWords();
+    Kernels.Zero(OutMask, NumWords);
+
+    // Union of the compiled neighbor sets of every state the cell can still take
+    WFCBits::ForEachSetBit(Wave.GetRow(CellIndex), NumWords, [this, Kernels, Direction, NumWords, OutMask](int32 StateIndex)
+    {
+        Kernels.Or(OutMask, Rules->GetAllowedNeighbors(StateIndex, Direction), NumWords);
+    });
+}
+
+template <typename KernelsType>
+bool FWFCSolver::UpdateCellPossibilities(KernelsType Kernels, int32 CellIndex, const uint64* AllowedMask)
+{
+    if (CellIndex < 0 || CellIndex >= Wave.GetNumCells())
+        return false;
+
+    int32 PreviousCount = Wave.GetCount(CellIndex);
+    int32 NewCount = Wave.CountIntersection(Kernels, CellIndex, AllowedMask);
+
+    if (NewCount == PreviousCount)
+        return false;
+
+    // Filter the possible states; a single remaining state means the cell is collapsed
+    // and none means a contradiction, which is recorded and not propagated any further
+    return RestrictCell(CellIndex, AllowedMask) > 0;
+}
+
+void FWFCSolver::PropagateBitmask()
+{
+    WFCBits::DispatchKernels(Wave.GetNumWords(), [this](auto Kernels)
+    {
+        PropagateBitmask(Kernels);
+    });
+}
+
+template <typename KernelsType>
+void FWFCSolver::PropagateBitmask(KernelsType Kernels)
+{
+    // Process the queue, stopping at the first cell left without states
+    while (!PropagationQueue.IsEmpty() && !HasContradiction())
+    {
+        Stats.PeakQueueDepth = FMath::Max(Stats.PeakQueueDepth, PropagationQueue.Num());
+        int32 CurrentCellIndex = PropagationQueue.Pop();
+        ++Stats.NumPropagations;
+
+        for (int32 Dir = 0; Dir < NumActiveDirections; ++Dir)
+        {
+            const EWFCDirection Direction = static_cast<EWFCDirection>(Dir);
+            const int32 NeighborIndex = GetNeighborIndex(CurrentCellIndex, Direction);
+
+            if (NeighborIndex == -1)
+                continue;
+
+            // Get the neighbors allowed in this direction by the current cell's possible states
+            GetAllowedNeighborMask(Kernels, CurrentCellIndex, Direction, NeighborMask.GetData());
+
+            // Update the neighbor's possible states based on constraint
+            if (UpdateCellPossibilities(Kernels, NeighborIndex, NeighborMask.GetData()))
+            {
+                PropagationQueue.Push(NeighborIndex);
+            }
+        }
+    }
+}
+
+void FWFCSolver::PropagateSupportCounts()
+{
+    while (BanStack.Num() > 0 && !HasContradiction())
+    {
+        Stats.PeakQueueDepth = FMath::Max(Stats.PeakQueueDepth, BanStack.Num());
+        const TPair<int32, int32> Removal = BanStack.Pop(EAllowShrinking::No);
+        ++Stats.NumPropagations;
+
+        // The state may have been banned already through another direction
+        if (Wave.Contains(Removal.Key, Removal.Value))
+        {
+            BanState(Removal.Key, Removal.Value);
+        }
+    }
+}
+
+void FWFCSolver::InitSupportCounts()
+{
+    const int32 NumTiles = Rules->GetNumTiles();
+    const int32 NumWords = Rules->GetNumWords();
+    const int32 NumDirections = NumActiveDirections;
+    checkf(NumTiles <= MAX_uint16, TEXT("Support counts are stored as uint16"));
+
+    // Count, for each tile and direction, how many tiles placed on that side allow it
+    InitialSupport.SetNumUninitialized(NumTiles * NumDirections, EAllowShrinking::No);
+    FMemory::Memzero(InitialSupport.GetData(), InitialSupport.Num() * sizeof(uint16));
+
+    for (int32 Other = 0; Other < NumTiles; ++Other)
+    {
+        for (int32 Dir = 0; Dir < NumDirections; ++Dir)
+        {
+            const EWFCDirection Opposite = FWFCCompiledRules::GetOppositeDirection(static_cast<EWFCDirection>(Dir));
+            WFCBits::ForEachSetBit(Rules->GetAllowedNeighbors(Other, Opposite), NumWords, [this, NumDirections, Dir](int32 Tile)
+            {
+                ++InitialSupport[Tile * NumDirections + Dir];
+            });
+        }
+    }
+
+    // Every cell starts with the full support of a neighbor in superposition
+    const int32 CellStride = InitialSupport.Num();
+    SupportCounts.SetNumUninitialized(Wave.GetNumCells() * CellStride, EAllowShrinking::No);
+    for (int32 i = 0; i < Wave.GetNumCells(); ++i)
+    {
+        FMemory::Memcpy(&SupportCounts[i * CellStride], InitialSupport.GetData(), CellStride * sizeof(uint16));
+    }
+
+    BanStack.Reset();
+    BanStack.Reserve(Wave.GetNumCells());
+}
+
+void FWFCSolver::BanState(int32 CellIndex, int32 State)
+{
+    Wave.Ban(CellIndex, State);
+    ++Stats.NumBans;
+    SumWeights[CellIndex] -= Rules->GetWeight(State);
+    SumWeightLogWeights[CellIndex] -= Rules->GetWeightLogWeight(State);
+
+    if (bRecordTrail)
+    {
+        Trail.Emplace(CellIndex, State);
+    }
+
+    if (Settings.Propagator == EWFCPropagator::SupportCount)
+    {
+        const int32 NumTiles = Rules->GetNumTiles();
+        const int32 NumWords = Rules->GetNumWords();
+
+        for (int32 Dir = 0; Dir < NumActiveDirections; ++Dir)
+        {
+            const EWFCDirection Direction = static_cast<EWFCDirection>(Dir);
+            const int32 NeighborIndex = GetNeighborIndex(CellIndex, Direction);
+
+            if (NeighborIndex == -1)
+                continue;
+
+            // The neighbor sees this cell from the opposite direction
+            const int32 Opposite = static_cast<int32>(FWFCCompiledRules::GetOppositeDirection(Direction));
+            uint16* NeighborSupport = &SupportCounts[NeighborIndex * NumTiles * NumActiveDirections];
+
+            // Every tile the removed state allowed in the neighbor loses one supporter.
+            // Counts are decremented right away so restoring the state can add them back exactly.
+            WFCBits::ForEachSetBit(Rules->GetAllowedNeighbors(State, Direction), NumWords, [this, NeighborIndex, Opposite, NeighborSupport](int32 NeighborState)
+            {
+                if (--NeighborSupport[NeighborState * NumActiveDirections + Opposite] == 0 && Wave.Contains(NeighborIndex, NeighborState))
+                {
+                    BanStack.Emplace(NeighborIndex, NeighborState);
+                }
+            });
+        }
+    }
+
+    OnCellStatesChanged(CellIndex);
+}
+
+void FWFCSolver::RestoreState(int32 CellIndex, int32 State)
+{
+    Wave.Unban(CellIndex, State);
+    SumWeights[CellIndex] += Rules->GetWeight(State);
+    SumWeightLogWeights[CellIndex] += Rules->GetWeightLogWeight(State);
+
+    if (Settings.Propagator == EWFCPropagator::SupportCount)
+    {
+        const int32 NumTiles = Rules->GetNumTiles();
+        const int32 NumWords = Rules->GetNumWords();
+
+        for (int32 Dir = 0; Dir < NumActiveDirections; ++Dir)
+        {
+            const EWFCDirection Direction = static_cast<EWFCDirection>(Dir);
+            const int32 NeighborIndex = GetNeighborIndex(CellIndex, Direction);
+
+            if (NeighborIndex == -1)
+                continue;
+
+            // Give back the support BanState took away
+            const int32 Opposite = static_cast<int32>(FWFCCompiledRules::GetOppositeDirection(Direction));
+            uint16* NeighborSupport = &SupportCounts[NeighborIndex * NumTiles * NumActiveDirections];
+            WFCBits::ForEachSetBit(Rules->GetAllowedNeighbors(State, Direction), NumWords, [this, Opposite, NeighborSupport](int32 NeighborState)
+            {
+                ++NeighborSupport[NeighborState * NumActiveDirections + Opposite];
+            });
+        }
+    }
+
+    // The cell was already reported when it first collapsed
+    OnCellStatesChanged(CellIndex, false);
+}
+
+int32 FWFCSolver::RestrictCell(int32 CellIndex, const uint64* Mask)
+{
+    // Take the removed states out first, since banning changes the row while it is walked
+    const int32 NumWords = Wave.GetNumWords();
+    const uint64* Row = Wave.GetRow(CellIndex);
+    uint64* Removed = RemovedMask.GetData();
+    for (int32 Word = 0; Word < NumWords; ++Word)
+    {
+        Removed[Word] = Row[Word] & ~Mask[Word];
+    }
+
+    if (Settings.Propagator == EWFCPropagator::Bitmask && !bRecordTrail)
+    {
+        WFCBits::ForEachSetBit(Removed, NumWords, [this, CellIndex](int32 State)
+        {
+            SumWeights[CellIndex] -= Rules->GetWeight(State);
+            SumWeightLogWeights[CellIndex] -= Rules->GetWeightLogWeight(State);
+            ++Stats.NumBans;
+        });
+
+        const int32 NewCount = Wave.Intersect(CellIndex, Mask);
+        OnCellStatesChanged(CellIndex);
+        return NewCount;
+    }
+
+    WFCBits::ForEachSetBit(Removed, NumWords, [this, CellIndex](int32 State)
+    {
+        BanState(CellIndex, State);
+    });
+
+    return Wave.GetCount(CellIndex);
+}
+
+void FWFCSolver::OnCellStatesChanged(int32 CellIndex, bool bRecordCollapse)
+{
+    const int32 Count = Wave.GetCount(CellIndex);
+
+    if (Count > 1)
+    {
+        EntropyIndex.Update(CellIndex, GetEntropy(CellIndex));
+        return;
+    }
+
+    EntropyIndex.Remove(CellIndex);
+
+    if (Count == 0)
+    {
+        // Keep the first empty cell; propagation stops as soon as one is found
+        if (ContradictionCell == INDEX_NONE)
+        {
+            ContradictionCell = CellIndex;
+            ++Stats.NumContradictions;
+        }
+        return;
+    }
+
+    if (bRecordCollapse && bRecordCollapses)
+    {
+        NewlyCollapsed.Add(GridIndices[CellIndex]);
+    }
+}
+
+bool FWFCSolver::ResolveContradiction()
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(WFC_ResolveContradiction);
+    SCOPE_CYCLE_COUNTER(STAT_WFC_ResolveContradiction);
+
+    while (HasContradiction())
+    {
+        if (Decisions.Num() > 0 && NumBacktracks < Settings.MaxBacktracks)
+        {
+            Backtrack();
+            continue;
+        }
+
+        if (Settings.LocalRestartRadius <= 0 || NumLocalRestarts >= Settings.MaxLocalRestarts)
+            return false;
+
+        // Grow the region on every restart in case the cause lies further away
+        RestartRegion(ContradictionCell, Settings.LocalRestartRadius * (NumLocalRestarts + 1));
+        ++NumLocalRestarts;
+    }
+
+    return true;
+}
+
+void FWFCSolver::Backtrack()
+{
+    const FDecision Decision = Decisions.Pop(EAllowShrinking::No);
+
+    ClearPendingPropagation();
+
+    // Undo every removal made since the observation, newest first
+    while (Trail.Num() > Decision.TrailSize)
+    {
+        const TPair<int32, int32> Removal = Trail.Pop(EAllowShrinking::No);
+        RestoreState(Removal.Key, Removal.Value);
+    }
+
+    ++NumBacktracks;
+
+    // The chosen state led to a contradiction, so rule it out instead.
+    // The ban lands on the trail of the previous decision and is undone with it.
+    BanState(Decision.Cell, Decision.State);
+
+    if (Settings.Propagator == EWFCPropagator::Bitmask)
+    {
+        PropagationQueue.Push(Decision.Cell);
+    }
+
+    PropagatePendingConstraints();
+}
+
+void FWFCSolver::RestartRegion(int32 CenterCell, int32 Radius)
+{
+    ClearPendingPropagation();
+
+    // Cells change outside the trail from here on, so earlier decisions can't be undone exactly
+    Trail.Reset();
+    Decisions.Reset();
+
+    FIntVector Center;
+    IndexToXYZ(GridIndices[CenterCell], Center.X, Center.Y, Center.Z);
+
+    // The region is a cube, flattened to a square on a single layer by the clamping
+    const FIntVector Min = Center - FIntVector(Radius);
+    const FIntVector Max = Center + FIntVector(Radius);
+
+    // Put the region back in superposition, keeping only the constraints it was seeded with
+    ForEachCellInBox(Min, Max, [this](int32 Cell)
+    {
+        Wave.ResetCell(Cell);
+
+        if (const int32* Offset = SeedMaskOffsets.Find(Cell))
+        {
+            Wave.Intersect(Cell, &SeedMasks[*Offset]);
+        }
+
+        RecomputeWeightSums(Cell);
+
+        OnCellStatesChanged(Cell);
+    });
+
+    // The region and the shell of cells around it see new neighbors
+    const FIntVector RingMin = Min - FIntVector(1);
+    const FIntVector RingMax = Max + FIntVector(1);
+
+    if (Settings.Propagator == EWFCPropagator::SupportCount)
+    {
+        const int32 NumTiles = Rules->GetNumTiles();
+        const int32 NumWords = Rules->GetNumWords();
+
+        ForEachCellInBox(RingMin, RingMax, [this](int32 Cell)
+        {
+            RecomputeSupportCounts(Cell);
+        });
+
+        // Queue every state that lost all support in some direction
+        ForEachCellInBox(RingMin, RingMax, [this, NumTiles, NumWords](int32 Cell)
+        {
+            const uint16* CellSupport = &SupportCounts[Cell * NumTiles * NumActiveDirections];
+
+            WFCBits::ForEachSetBit(Wave.GetRow(Cell), NumWords, [this, Cell, CellSupport](int32 State)
+            {
+                for (int32 Dir = 0; Dir < NumActiveDirections; ++Dir)
+                {
+                    if (GetNeighborIndex(Cell, static_cast<EWFCDirection>(Dir)) != -1 && CellSupport[State * NumActiveDirections + Dir] == 0)
+                    {
+                        BanStack.Emplace(Cell, State);
+                        break;
+                    }
+                }
+            });
+        });
+    }
+    else
+    {
+        ForEachCellInBox(RingMin, RingMax, [this](int32 Cell)
+        {
+            PropagationQueue.Push(Cell);
+        });
+    }
+
+    PropagatePendingConstraints();
+}
+
+float FWFCSolver::GetEntropy(int32 CellIndex) const
+{
+    return ComputeEntropy(SumWeights[CellIndex], SumWeightLogWeights[CellIndex]) + EntropyNoise[CellIndex];
+}
+
+void FWFCSolver::RecomputeWeightSums(int32 CellIndex)
+{
+    double Weight = 0.0;
+    double WeightLogWeight = 0.0;
+    WFCBits::ForEachSetBit(Wave.GetRow(CellIndex), Wave.GetNumWords(), [this, &Weight, &WeightLogWeight](int32 State)
+    {
+        Weight += Rules->GetWeight(State);
+        WeightLogWeight += Rules->GetWeightLogWeight(State);
+    });
+
+    SumWeights[CellIndex] = Weight;
+    SumWeightLogWeights[CellIndex] = WeightLogWeight;
+}
+
+void FWFCSolver::RecomputeSupportCounts(int32 CellIndex)
+{
+    const int32 NumTiles = Rules->GetNumTiles();
+    const int32 NumWords = Rules->GetNumWords();
+    uint16* CellSupport = &SupportCounts[CellIndex * NumTiles * NumActiveDirections];
+    FMemory::Memzero(CellSupport, NumTiles * NumActiveDirections * sizeof(uint16));
+
+    for (int32 Dir = 0; Dir < NumActiveDirections; ++Dir)
+    {
+        const EWFCDirection Direction = static_cast<EWFCDirection>(Dir);
+        const int32 NeighborIndex = GetNeighborIndex(CellIndex, Direction);
+
+        // Supports across the grid border are never read
+        if (NeighborIndex == -1)
+            continue;
+
+        // Each state left in the neighbor supports the tiles it allows on this side
+        const EWFCDirection Opposite = FWFCCompiledRules::GetOppositeDirection(Direction);
+        WFCBits::ForEachSetBit(Wave.GetRow(NeighborIndex), NumWords, [this, Opposite, NumWords, CellSupport, Dir](int32 NeighborState)
+        {
+            WFCBits::ForEachSetBit(Rules->GetAllowedNeighbors(NeighborState, Opposite), NumWords, [this, CellSupport, Dir](int32 State)
+            {
+                ++CellSupport[State * NumActiveDirections + Dir];
+            });
+        });
+    }
+}
+
+void FWFCSolver::TrimDecisions()
+{
+    const int32 Depth = Settings.BacktrackDepth;
+    if (Decisions.Num() <= Depth * 2)
+        return;
+
+    // Trim in batches so the trail isn't shifted on every observation
+    const int32 NumDropped = Decisions.Num() - Depth;
+    const int32 TrailDropped = Decisions[NumDropped].TrailSize;
+
+    Trail.RemoveAt(0, TrailDropped, EAllowShrinking::No);
+    Decisions.RemoveAt(0, NumDropped, EAllowShrinking::No);
+
+    for (FDecision& Decision : Decisions)
+    {
+        Decision.TrailSize -= TrailDropped;
+    }
+}
+
+void FWFCSolver::ClearPendingPropagation()
+{
+    PropagationQueue.Clear();
+    BanStack.Reset();
+    ContradictionCell = INDEX_NONE;
+}
+
+bool FWFCSolver::IsGridFullyCollapsed() const
+{
+    // Cells leave the entropy index as soon as they collapse
+    return EntropyIndex.IsEmpty();
+}
+
+int32 FWFCSolver::FindInvalidCell(const FWFCCompiledRules& Rules, int32 Width, int32 Height, const TArray<int32>& States, int32 Depth)
+{
+    if (States.Num() != Width * Height * Depth)
+        return 0;
+
+    // Each pair is checked once, from the cell on its west, north or upper side.
+    // Rules may be asymmetric, so both sides of it are tested like propagation does.
+    static const EWFCDirection Forward[] = { EWFCDirection::East, EWFCDirection::South, EWFCDirection::Down };
+
+    for (int32 Z = 0; Z < Depth; ++Z)
+    {
+        for (int32 Y = 0; Y < Height; ++Y)
+        {
+            for (int32 X = 0; X < Width; ++X)
+            {
+                const int32 Index = (Z * Height + Y) * Width + X;
+                const int32 Tile = States[Index];
+                if (Tile < 0 || Tile >= Rules.GetNumTiles())
+                    return Index;
+
+                for (EWFCDirection Direction : Forward)
+                {
+                    const FIntVector Neighbor = FIntVector(X, Y, Z) + FWFCCompiledRules::GetOffset(Direction);
+                    if (Neighbor.X >= Width || Neighbor.Y >= Height || Neighbor.Z < 0)
+                        continue;
+
+                    const int32 Other = States[(Neighbor.Z * Height + Neighbor.Y) * Width + Neighbor.X];
+                    const EWFCDirection Back = FWFCCompiledRules::GetOppositeDirection(Direction);
+                    if (Other >= 0 && (!WFCBits::Test(Rules.GetAllowedNeighbors(Tile, Direction), Other) || !WFCBits::Test(Rules.GetAllowedNeighbors(Other, Back), Tile)))
+                        return Index;
+                }
+            }
+        }
+    }
+
+    return -1;
+}
+
+int32 FWFCSolver::DeriveSeed(int32 Seed, uint32 Salt)
+{
+    return static_cast<int32>(HashCombine(GetTypeHash(Seed), Salt));
+}
+
+void FWFCSolver::IndexToXY(int32 Index, int32& OutX, int32& OutY) const
+{
+    OutX = Index % Settings.Width;
+    OutY = (Index / Settings.Width) % Settings.Height;
+}
+
+int32 FWFCSolver::XYToIndex(int32 X, int32 Y) const
+{
+    return Y * Settings.Width + X;
+}
+
+void FWFCSolver::IndexToXYZ(int32 Index, int32& OutX, int32& OutY, int32& OutZ) const
+{
+    OutX = Index % Settings.Width;
+    OutY = (Index / Settings.Width) % Settings.Height;
+    OutZ = Index / (Settings.Width * Settings.Height);
+}
+
+int32 FWFCSolver::XYZToIndex(int32 X, int32 Y, int32 Z) const
+{
+    return (Z * Settings.Height + Y) * Settings.Width + X;
+}
+
+void FWFCSolver::BuildLayout()
+{
+    const int32 Width = Settings.Width;
+    const int32 Height = Settings.Height;
+    const int32 Depth = Settings.Depth;
+    const int32 NumCells = Width * Height * Depth;
+
+    // Flat grids have no neighbors above or below, so their bricks are a single layer thick
+    const int32 BrickDepth = Depth > 1 ? BrickSize : 1;
+
+    // Bricks at the far borders are cut short rather than padded, so every stored index is a cell
+    StorageIndices.SetNumUninitialized(NumCells, EAllowShrinking::No);
+    GridIndices.SetNumUninitialized(NumCells, EAllowShrinking::No);
+    int32 NextIndex = 0;
+
+    for (int32 BrickZ = 0; BrickZ < Depth; BrickZ += BrickDepth)
+    {
+        for (int32 BrickY = 0; BrickY < Height; BrickY += BrickSize)
+        {
+            for (int32 BrickX = 0; BrickX < Width; BrickX += BrickSize)
+            {
+                for (int32 Z = BrickZ; Z < FMath::Min(BrickZ + BrickDepth, Depth); ++Z)
+                {
+                    for (int32 Y = BrickY; Y < FMath::Min(BrickY + BrickSize, Height); ++Y)
+                    {
+                        for (int32 X = BrickX; X < FMath::Min(BrickX + BrickSize, Width); ++X)
+                        {
+                            const int32 GridIndex = XYZToIndex(X, Y, Z);
+                            StorageIndices[GridIndex] = NextIndex;
+                            GridIndices[NextIndex] = GridIndex;
+                            ++NextIndex;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    const int32 NumDirections = FWFCCompiledRules::NumDirections;
+    Neighbors.SetNumUninitialized(NumCells * NumDirections, EAllowShrinking::No);
+
+    for (int32 Cell = 0; Cell < NumCells; ++Cell)
+    {
+        FIntVector Position;
+        IndexToXYZ(GridIndices[Cell], Position.X, Position.Y, Position.Z);
+
+        for (int32 Dir = 0; Dir < NumDirections; ++Dir)
+        {
+            const FIntVector Neighbor = Position + FWFCCompiledRules::GetOffset(static_cast<EWFCDirection>(Dir));
+            const bool bInside = Neighbor.X >= 0 && Neighbor.X < Width && Neighbor.Y >= 0 && Neighbor.Y < Height && Neighbor.Z >= 0 && Neighbor.Z < Depth;
+            Neighbors[Cell * NumDirections + Dir] = bInside ? StorageIndices[XYZToIndex(Neighbor.X, Neighbor.Y, Neighbor.Z)] : -1;
+        }
+    }
+}
+
+void FWFCSolver::ForEachCellInBox(FIntVector Min, FIntVector Max, TFunctionRef<void(int32)> Func) const
+{
+    Min = FIntVector(FMath::Max(Min.X, 0), FMath::Max(Min.Y, 0), FMath::Max(Min.Z, 0));
+    Max = FIntVector(FMath::Min(Max.X, Settings.Width - 1), FMath::Min(Max.Y, Settings.Height - 1), FMath::Min(Max.Z, Settings.Depth - 1));
+
+    for (int32 Z = Min.Z; Z <= Max.Z; ++Z)
+    {
+        for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+        {
+            for (int32 X = Min.X; X <= Max.X; ++X)
+            {
+                Func(StorageIndices[XYZToIndex(X, Y, Z)]);
+            }
+        }
+    }
+}
@@ -0,0 +1,353 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WFCTypes.h"
+#include "WFCRules.h"
+#include "WFCWave.h"
+#include "WFCEntropyIndex.h"
+#include "WFCCellQueue.h"
+#include "WFCConstraints.h"
+#include <atomic>
+
+// Parameters of a single solve
+struct FWFCSolverSettings
+{
+    int32 Width = 0;
+    int32 Height = 0;
+
+    // Number of layers stacked along Z, linked through the Up and Down faces; 1 for a flat grid
+    int32 Depth = 1;
+
+    EWFCPropagator Propagator = EWFCPropagator::Bitmask;
+
+    // Seed of the random stream used to observe cells; the same seed and rules give the same grid
+    int32 Seed = 0;
+
+    // Safety limit on observations; 0 uses ten times the cell count
+    int32 MaxIterations = 0;
+
+    // Number of most recent observations that can be undone after a contradiction; 0 disables backtracking
+    int32 BacktrackDepth = 0;
+
+    // Total number of observations that may be undone during one solve
+    int32 MaxBacktracks = 0;
+
+    // Half size of the cube of cells reset around a contradiction backtracking could not resolve; 0 disables it
+    int32 LocalRestartRadius = 0;
+
+    // Number of local restarts before the solve gives up
+    int32 MaxLocalRestarts = 0;
+
+    // Tiles cells are restricted to before the first observation, by grid index of this grid; may be null.
+    // Shared, so copies of the settings handed to worker threads don't copy the masks.
+    TSharedPtr<const FWFCInitialConstraints, ESPMode::ThreadSafe> Constraints;
+};
+
+// Work done by the solver since Init
+struct FWFCSolverStats
+{
+    // Cells whose neighbors were re-derived by the bitmask propagator, or queued bans handled by the support count one
+    int64 NumPropagations = 0;
+
+    // States removed from cells, including those of observations
+    int64 NumBans = 0;
+
+    // Times a cell ran out of states
+    int32 NumContradictions = 0;
+
+    // Most cells (bitmask) or bans (support counts) waiting to be propagated at once
+    int32 PeakQueueDepth = 0;
+};
+
+// Result of advancing the solver
+enum class EWFCSolveStatus : uint8
+{
+    // There are still cells to collapse
+    Running,
+
+    // Every cell is collapsed
+    Completed,
+
+    // The iteration limit was hit or no cell could be observed
+    Incomplete,
+
+    // The solve was cancelled from outside
+    Cancelled,
+
+    // A cell ran out of states and neither backtracking nor a local restart could fix it
+    Failed
+};
+
+// The observe / collapse / propagate loop for one grid.
+// It holds no UObject references, so a solver can run on any thread as long as
+// nothing else touches it while it does.
+// Cell indices in the public interface are grid indices, row by row and layer by layer (see XYZToIndex).
+// Internally cells are stored in small bricks so that the neighbors of a cell are close to it in memory.
+class WFC_API FWFCSolver
+{
+public:
+    typedef TSharedRef<const FWFCCompiledRules, ESPMode::ThreadSafe> FRulesRef;
+
+    // Put every cell of a new grid in full superposition, then apply and propagate the initial constraints
+    void Init(FRulesRef InRules, const FWFCSolverSettings& InSettings);
+
+    // Release the wave and scratch buffers
+    void Reset();
+
+    // Forget the grid and the rules but keep every buffer allocated, so the next Init of a grid
+    // no larger than this one doesn't allocate
+    void Clear();
+
+    // Observe one cell and propagate its constraints
+    EWFCSolveStatus Step();
+
+    // Step until the grid is solved, the iteration limit is hit or bCancelled is raised
+    EWFCSolveStatus Run(const std::atomic<bool>* bCancelled = nullptr);
+
+    // Check if all cells have been collapsed
+    bool IsGridFullyCollapsed() const;
+
+    // Restrict a cell to the states set in AllowedMask without propagating yet.
+    // Returns false and leaves the cell untouched if no state would be left.
+    // Constraints kept on restart are applied again whenever a local restart resets the cell.
+    bool ConstrainCell(int32 GridIndex, const uint64* AllowedMask, bool bKeepOnRestart = true);
+
+    // Propagate every constraint applied since the last propagation in a single pass
+    void PropagatePendingConstraints();
+
+    // Tile index of every cell, -1 for cells that are not collapsed
+    void GetFinalStates(TArray<int32>& OutStates) const;
+
+    // Keep a list of the cells that collapse, for callers that want to show tiles as they appear.
+    // Call before Init.
+    void SetRecordCollapses(bool bRecord);
+
+    // Take the cells that collapsed since the last call.
+    // The buffers of OutCells and the solver's list are swapped, so a caller that keeps OutCells doesn't allocate.
+    void ConsumeNewlyCollapsed(TArray<int32>& OutCells);
+
+    // Fraction of cells collapsed so far, from 0 to 1
+    float GetProgress() const;
+
+    // Possible tile indices of a cell, in increasing order
+    void GetCellStates(int32 CellIndex, TArray<int32>& OutStates) const { Wave.GetStates(StorageIndices[CellIndex], OutStates); }
+
+    // Is a cell down to a single state?
+    bool IsCellCollapsed(int32 CellIndex) const { return Wave.IsCollapsed(StorageIndices[CellIndex]); }
+
+    // Lowest tile index a cell can still take, -1 if it has none
+    int32 GetCellState(int32 CellIndex) const { return Wave.GetFirstState(StorageIndices[CellIndex]); }
+
+    int32 GetNumCells() const { return Wave.GetNumCells(); }
+
+    // Rules the wave was initialized with, null after Clear or Reset
+    const FWFCCompiledRules* GetRules() const { return Rules.Get(); }
+
+    int32 GetWidth() const { return Settings.Width; }
+    int32 GetHeight() const { return Settings.Height; }
+    int32 GetDepth() const { return Settings.Depth; }
+    int32 GetIterationCount() const { return IterationCount; }
+    int32 GetMaxIterations() const { return MaxIterations; }
+
+    // True while some cell has no state left
+    bool HasContradiction() const { return ContradictionCell != INDEX_NONE; }
+
+    // Observations undone and local restarts made so far
+    int32 GetNumBacktracks() const { return NumBacktracks; }
+    int32 GetNumLocalRestarts() const { return NumLocalRestarts; }
+
+    const FWFCSolverStats& GetStats() const { return Stats; }
+
+    // Heap memory held by the wave, entropy index and scratch buffers
+    SIZE_T GetAllocatedSize() const;
+
+    // First cell of a solved grid that has no tile, or whose tile and its east, south or lower neighbor
+    // don't allow each other. Returns -1 if every adjacent pair satisfies the rules.
+    static int32 FindInvalidCell(const FWFCCompiledRules& Rules, int32 Width, int32 Height, const TArray<int32>& States, int32 Depth = 1);
+
+    // Seed for an independent stream derived from Seed, e.g. for one region of a larger solve
+    static int32 DeriveSeed(int32 Seed, uint32 Salt);
+
+    // Convert a grid index to a 2D position, dropping the layer
+    void IndexToXY(int32 Index, int32& OutX, int32& OutY) const;
+
+    // Convert a 2D position on the first layer to a grid index
+    int32 XYToIndex(int32 X, int32 Y) const;
+
+    // Convert a grid index to a 3D position
+    void IndexToXYZ(int32 Index, int32& OutX, int32& OutY, int32& OutZ) const;
+
+    // Convert a 3D position to a grid index
+    int32 XYZToIndex(int32 X, int32 Y, int32 Z) const;
+
+private:
+    // An observation that can be undone
+    struct FDecision
+    {
+        int32 Cell;
+        int32 State;
+
+        // Trail length before the observation was applied
+        int32 TrailSize;
+    };
+
+    // Find the cell with the lowest Shannon entropy
+    int32 FindCellWithLowestEntropy() const;
+
+    // Collapse a single cell to a definite state
+    void CollapseCell(int32 CellIndex);
+
+    // Propagate constraints after a cell has been collapsed
+    void PropagateConstraints(int32 CellIndex);
+
+    // Propagate by re-deriving the allowed states of each neighbor of the queued cells
+    void PropagateBitmask();
+
+    // The propagation loop itself, with bitset kernels picked once for the tile set's word count
+    template <typename KernelsType>
+    void PropagateBitmask(KernelsType Kernels);
+
+    // Propagate the removals queued on the ban stack using support counts
+    void PropagateSupportCounts();
+
+    // Fill the support counts for a grid in full superposition
+    void InitSupportCounts();
+
+    // Remove a state from a cell, record it on the trail and, with support counts,
+    // take its support away from the neighbors
+    void BanState(int32 CellIndex, int32 State);
+
+    // Put back a state removed since the last undoable decision
+    void RestoreState(int32 CellIndex, int32 State);
+
+    // Remove every state of the cell not set in Mask and return the number left
+    int32 RestrictCell(int32 CellIndex, const uint64* Mask);
+
+    // Shannon entropy of a cell's weighted states, plus the cell's tiebreak noise
+    float GetEntropy(int32 CellIndex) const;
+
+    // Recompute the weight sums of a cell from its states
+    void RecomputeWeightSums(int32 CellIndex);
+
+    // Keep the entropy index and collapse log in sync after the states of a cell changed
+    void OnCellStatesChanged(int32 CellIndex, bool bRecordCollapse = true);
+
+    // Undo decisions or restart part of the grid until no cell is empty; false if the budgets ran out
+    bool ResolveContradiction();
+
+    // Undo the most recent observation and remove the state it picked
+    void Backtrack();
+
+    // Reset the cells around a contradiction to the constraints they started with
+    void RestartRegion(int32 CenterCell, int32 Radius);
+
+    // Recount the support of every state of a cell from its current neighbors
+    void RecomputeSupportCounts(int32 CellIndex);
+
+    // Forget decisions older than the backtrack depth along with their part of the trail
+    void TrimDecisions();
+
+    // Drop everything waiting to be propagated
+    void ClearPendingPropagation();
+
+    // Combine the neighbors allowed in a direction by each of the cell's possible states
+    template <typename KernelsType>
+    void GetAllowedNeighborMask(KernelsType Kernels, int32 CellIndex, EWFCDirection Direction, uint64* OutMask) const;
+
+    // Update possible states of a neighboring cell
+    template <typename KernelsType>
+    bool UpdateCellPossibilities(KernelsType Kernels, int32 CellIndex, const uint64* AllowedMask);
+
+    // Get the stored index of the neighbor in a direction, or -1 at the grid border
+    int32 GetNeighborIndex(int32 Index, EWFCDirection Direction) const
+    {
+        return Neighbors[Index * FWFCCompiledRules::NumDirections + static_cast<int32>(Direction)];
+    }
+
+    // Order the cells brick by brick and build the neighbor table for that order
+    void BuildLayout();
+
+    // Call Func with the stored index of every cell inside the box from Min to Max, both inclusive and clamped to the grid
+    void ForEachCellInBox(FIntVector Min, FIntVector Max, TFunctionRef<void(int32)> Func) const;
+
+    // Adjacency rules shared with whoever started the solve
+    TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> Rules;
+
+    FWFCSolverSettings Settings;
+
+    // Directions a cell has neighbors in: all six on a layered grid, only the four horizontal ones on a flat grid.
+    // Propagation loops and the support count stride only cover these.
+    int32 NumActiveDirections = FWFCCompiledRules::NumHorizontalDirections;
+
+    // Possible states of every cell in the grid, in storage order.
+    // Every other per cell array below, and every cell index inside the solver, uses that order too.
+    FWFCWave Wave;
+
+    // Stored index of each grid index, and grid index of each stored cell
+    TArray<int32> StorageIndices;
+    TArray<int32> GridIndices;
+
+    // Stored index of the neighbor of each stored cell in each direction, -1 at the grid border.
+    // Propagation walks this table instead of converting indices to positions and back.
+    TArray<int32> Neighbors;
+
+    // Uncollapsed cells ordered by entropy, kept up to date as states are removed
+    FWFCEntropyIndex EntropyIndex;
+
+    // Sum of w and of w * log(w) over the states of each cell, so entropy is updated in O(1) per ban
+    TArray<double> SumWeights;
+    TArray<double> SumWeightLogWeights;
+
+    // Small random offset per cell that breaks ties between cells of equal entropy
+    TArray<float> EntropyNoise;
+
+    // Cells whose neighbors still have to be updated by the bitmask propagator
+    FWFCCellQueue PropagationQueue;
+
+    // Scratch bitsets of NumWords each, sized in Init so that solving never allocates: the states allowed
+    // in a neighbor, the states removed from a cell and the single state picked by an observation
+    TArray<uint64> NeighborMask;
+    TArray<uint64> RemovedMask;
+    TArray<uint64> ChosenMask;
+
+    // Support of each tile from a neighbor in superposition, indexed [Tile][Direction] over the active directions
+    TArray<uint16> InitialSupport;
+
+    // Support counts for the support count propagator, indexed [Cell][Tile][Direction] over the active directions.
+    // Each entry is the number of states in the neighbor in that direction that allow the tile.
+    TArray<uint16> SupportCounts;
+
+    // (Cell, Tile) pairs whose support dropped to zero, waiting to be banned by the support count propagator
+    TArray<TPair<int32, int32>> BanStack;
+
+    // (Cell, Tile) removals since the oldest decision that can still be undone
+    TArray<TPair<int32, int32>> Trail;
+    bool bRecordTrail = false;
+
+    // Observations that can be undone, oldest first
+    TArray<FDecision> Decisions;
+
+    // Constraints applied again by a local restart, as a NumWords mask per constrained cell
+    TMap<int32, int32> SeedMaskOffsets;
+    TArray<uint64> SeedMasks;
+
+    // First cell found without states, or INDEX_NONE
+    int32 ContradictionCell = INDEX_NONE;
+
+    int32 NumBacktracks = 0;
+    int32 NumLocalRestarts = 0;
+
+    FWFCSolverStats Stats;
+
+    // Picks the state of each observed cell
+    FRandomStream RandomStream;
+
+    // Grid indices of the cells collapsed since the last ConsumeNewlyCollapsed, when recording
+    TArray<int32> NewlyCollapsed;
+    bool bRecordCollapses = false;
+
+    int32 MaxIterations = 0;
+    int32 IterationCount = 0;
+};
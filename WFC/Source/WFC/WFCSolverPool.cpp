@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCSolverPool.h"
+#include "Misc/ScopeLock.h"
+
+FWFCSolverPool& FWFCSolverPool::Get()
+{
+    static FWFCSolverPool Pool;
+    return Pool;
+}
+
+TUniquePtr<FWFCSolver> FWFCSolverPool::Acquire()
+{
+    {
+        FScopeLock ScopeLock(&Lock);
+        if (FreeSolvers.Num() > 0)
+            return FreeSolvers.Pop(EAllowShrinking::No);
+    }
+
+    return MakeUnique<FWFCSolver>();
+}
+
+void FWFCSolverPool::Release(TUniquePtr<FWFCSolver>&& Solver)
+{
+    if (!Solver)
+        return;
+
+    // Don't keep the compiled rules alive through an idle solver
+    Solver->Clear();
+
+    // One solver per core covers every worker solving at once plus the game thread
+    FScopeLock ScopeLock(&Lock);
+    if (FreeSolvers.Num() < FPlatformMisc::NumberOfCoresIncludingHyperthreads())
+    {
+        FreeSolvers.Add(MoveTemp(Solver));
+    }
+}
+
+void FWFCSolverPool::Empty()
+{
+    // Free the solvers outside the lock
+    TArray<TUniquePtr<FWFCSolver>> Solvers;
+    {
+        FScopeLock ScopeLock(&Lock);
+        Solvers = MoveTemp(FreeSolvers);
+    }
+}
+
+int32 FWFCSolverPool::Num() const
+{
+    FScopeLock ScopeLock(&Lock);
+    return FreeSolvers.Num();
+}
+
+SIZE_T FWFCSolverPool::GetAllocatedSize() const
+{
+    FScopeLock ScopeLock(&Lock);
+    SIZE_T Size = FreeSolvers.GetAllocatedSize();
+    for (const TUniquePtr<FWFCSolver>& Solver : FreeSolvers)
+    {
+        Size += sizeof(FWFCSolver) + Solver->GetAllocatedSize();
+    }
+    return Size;
+}
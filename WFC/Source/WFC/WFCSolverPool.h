@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WFCSolver.h"
+
+// Solvers kept between solves, so that their wave, entropy index, queues and scratch bitsets
+// are reused instead of being allocated again for every generation, region and batch entry.
+// A solver only allocates when it is asked to solve a larger grid or tile set than it has before,
+// so regenerating grids of the same size runs without heap allocations once the pool is warm.
+struct WFC_API FWFCSolverPool
+{
+    // A solver borrowed from the pool for the lifetime of this object, then handed back with its buffers
+    struct FScopedSolver : public FNoncopyable
+    {
+        FScopedSolver() : Solver(FWFCSolverPool::Get().Acquire()) {}
+        ~FScopedSolver() { FWFCSolverPool::Get().Release(MoveTemp(Solver)); }
+
+        FWFCSolver& operator*() const { return *Solver; }
+        FWFCSolver* operator->() const { return Solver.Get(); }
+
+    private:
+        TUniquePtr<FWFCSolver> Solver;
+    };
+
+    // Pool shared by every grid, safe to use from any thread
+    static FWFCSolverPool& Get();
+
+    // A free solver, or a new one if they are all in use
+    TUniquePtr<FWFCSolver> Acquire();
+
+    // Give a solver back once its results have been read. It drops its rules but keeps its buffers,
+    // unless the pool already holds one solver per core, in which case it is freed.
+    void Release(TUniquePtr<FWFCSolver>&& Solver);
+
+    // Free every pooled solver, e.g. after leaving a level with very large grids
+    void Empty();
+
+    // Number of free solvers and the heap memory they hold
+    int32 Num() const;
+    SIZE_T GetAllocatedSize() const;
+
+private:
+    mutable FCriticalSection Lock;
+    TArray<TUniquePtr<FWFCSolver>> FreeSolvers;
+};
@@ -0,0 +1,17 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCStats.h"
+
+DEFINE_STAT(STAT_WFC_GenerateGrid);
+DEFINE_STAT(STAT_WFC_Solve);
+DEFINE_STAT(STAT_WFC_SolverInit);
+DEFINE_STAT(STAT_WFC_FindLowestEntropy);
+DEFINE_STAT(STAT_WFC_CollapseCell);
+DEFINE_STAT(STAT_WFC_PropagateConstraints);
+DEFINE_STAT(STAT_WFC_ResolveContradiction);
+DEFINE_STAT(STAT_WFC_SpawnTileMeshes);
+
+DEFINE_STAT(STAT_WFC_StatesBanned);
+DEFINE_STAT(STAT_WFC_Iterations);
+DEFINE_STAT(STAT_WFC_PeakQueueDepth);
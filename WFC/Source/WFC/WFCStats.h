@@ -0,0 +1,23 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+// Stats shown by "stat WFC"; every cycle counter is paired with a trace scope of the same name for Insights
+DECLARE_STATS_GROUP(TEXT("WFC"), STATGROUP_WFC, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate Grid"), STAT_WFC_GenerateGrid, STATGROUP_WFC, WFC_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Solve"), STAT_WFC_Solve, STATGROUP_WFC, WFC_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Solver Init"), STAT_WFC_SolverInit, STATGROUP_WFC, WFC_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Find Lowest Entropy"), STAT_WFC_FindLowestEntropy, STATGROUP_WFC, WFC_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Collapse Cell"), STAT_WFC_CollapseCell, STATGROUP_WFC, WFC_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Propagate Constraints"), STAT_WFC_PropagateConstraints, STATGROUP_WFC, WFC_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Resolve Contradiction"), STAT_WFC_ResolveContradiction, STATGROUP_WFC, WFC_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Spawn Tile Meshes"), STAT_WFC_SpawnTileMeshes, STATGROUP_WFC, WFC_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("States Banned"), STAT_WFC_StatesBanned, STATGROUP_WFC, WFC_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Iterations"), STAT_WFC_Iterations, STATGROUP_WFC, WFC_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Peak Queue Depth"), STAT_WFC_PeakQueueDepth, STATGROUP_WFC, WFC_API);
@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCSubsystem.h"
+#include "WaveFunctionCollapseComponent.h"
+#include "WFCSolverPool.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Tasks/Task.h"
+
+namespace
+{
+    // One grid of a batch, solved on whichever worker picks it up
+    struct FBatchJob
+    {
+        TWeakObjectPtr<UWaveFunctionCollapseComponent> Component;
+        UWaveFunctionCollapseComponent::FGenerationHandle Generation;
+        TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> Rules;
+        FWFCSolverSettings Settings;
+        int32 RegionSize = 0;
+
+        // Index of the component in the batch request
+        int32 ResultIndex = 0;
+
+        EWFCSolveStatus Status = EWFCSolveStatus::Cancelled;
+        int32 MaxIterations = 0;
+        TArray<int32> States;
+    };
+}
+
+void UWFCSubsystem::GenerateBatch(const TArray<UWaveFunctionCollapseComponent*>& Components, FWFCBatchCompleteSignature OnComplete)
+{
+    TArray<bool> Results;
+    Results.Init(false, Components.Num());
+
+    // Rules are compiled on the game thread, then shared by every request with the same hash
+    TMap<uint64, TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe>> SharedRules;
+    TArray<FBatchJob> Jobs;
+    Jobs.Reserve(Components.Num());
+
+    for (int32 i = 0; i < Components.Num(); ++i)
+    {
+        UWaveFunctionCollapseComponent* Component = Components[i];
+        if (!Component)
+            continue;
+
+        FBatchJob Job;
+        bool bCompleted = false;
+        Job.Generation = Component->BeginAsyncGeneration(Job.Settings, Job.RegionSize, bCompleted);
+        if (!Job.Generation)
+        {
+            // Invalid rules, or a cached grid that has already been spawned
+            Results[i] = bCompleted;
+            continue;
+        }
+
+        TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> Rules = Component->GetCompiledRules();
+        Job.Rules = SharedRules.FindOrAdd(Rules->GetHash(), Rules);
+        Job.Component = Component;
+        Job.ResultIndex = i;
+        Jobs.Add(MoveTemp(Job));
+    }
+
+    if (Jobs.Num() == 0)
+    {
+        OnComplete.ExecuteIfBound(Results);
+        return;
+    }
+
+    ++NumRunningBatches;
+    TWeakObjectPtr<UWFCSubsystem> WeakThis(this);
+
+    UE::Tasks::Launch(UE_SOURCE_LOCATION, [WeakThis, Jobs = MoveTemp(Jobs), Results = MoveTemp(Results), OnComplete]() mutable
+    {
+        TRACE_CPUPROFILER_EVENT_SCOPE(WFC_GenerateBatch);
+
+        ParallelFor(Jobs.Num(), [&Jobs](int32 Index)
+        {
+            FBatchJob& Job = Jobs[Index];
+            if (Job.Generation->bCancelled)
+                return;
+
+            // Each worker borrows a pooled solver, so its wave, queues and trail are reused from grid to grid and batch to batch.
+            // It solves like GenerateGridAsync would, parallel regions included, so a batch gives the same grid for a seed.
+            FWFCSolverPool::FScopedSolver Solver;
+            Job.Status = UWaveFunctionCollapseComponent::RunSolve(*Solver, Job.Rules.ToSharedRef(), Job.Settings, Job.RegionSize, &Job.Generation->bCancelled);
+            Job.MaxIterations = Solver->GetMaxIterations();
+            Solver->GetFinalStates(Job.States);
+        });
+
+        AsyncTask(ENamedThreads::GameThread, [WeakThis, Jobs = MoveTemp(Jobs), Results = MoveTemp(Results), OnComplete]() mutable
+        {
+            for (FBatchJob& Job : Jobs)
+            {
+                UWaveFunctionCollapseComponent* Component = Job.Component.Get();
+                if (Component && Job.Status != EWFCSolveStatus::Cancelled)
+                {
+                    // A component regenerated since the batch started keeps its newer grid
+                    const bool bApplied = Component->FinishAsyncGeneration(Job.Generation, Job.Status, Job.MaxIterations, MoveTemp(Job.States));
+                    Results[Job.ResultIndex] = bApplied && Job.Status == EWFCSolveStatus::Completed;
+                }
+            }
+
+            if (UWFCSubsystem* This = WeakThis.Get())
+            {
+                --This->NumRunningBatches;
+            }
+
+            OnComplete.ExecuteIfBound(Results);
+        });
+    });
+}
@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WFCSubsystem.generated.h"
+
+class UWaveFunctionCollapseComponent;
+
+// Called once a whole batch is done, with whether each grid was generated, in request order
+DECLARE_DYNAMIC_DELEGATE_OneParam(FWFCBatchCompleteSignature, const TArray<bool>&, Results);
+
+// Generates many independent grids at once, e.g. every room of a level at match start.
+// The grids of a batch are spread over the task graph workers instead of each taking a
+// worker of its own, and every grid is solved in a pooled solver whose buffers are reused.
+UCLASS()
+class WFC_API UWFCSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+    // Generate the grid of every component with its own settings, off the game thread.
+    // Components that compile to the same rules share one adjacency table for the batch.
+    // Each component spawns its tiles and broadcasts OnGenerationComplete as usual,
+    // then OnComplete is called once for the whole batch.
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse")
+    void GenerateBatch(const TArray<UWaveFunctionCollapseComponent*>& Components, FWFCBatchCompleteSignature OnComplete);
+
+    // Are any batches still being solved?
+    UFUNCTION(BlueprintPure, Category = "WaveFunctionCollapse")
+    bool IsBatchRunning() const { return NumRunningBatches > 0; }
+
+private:
+    int32 NumRunningBatches = 0;
+};
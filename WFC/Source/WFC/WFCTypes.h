@@ -0,0 +1,352 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WFCTypes.generated.h"
+
+class UStaticMesh;
+
+// Enum to represent connection types on tile edges
+UENUM(BlueprintType)
+enum class ETileEdgeType : uint8
+{
+    Type_A UMETA(DisplayName = "Type A"),
+    Type_B UMETA(DisplayName = "Type B"),
+    Type_C UMETA(DisplayName = "Type C"),
+    Type_D UMETA(DisplayName = "Type D")
+    // Add more types as needed
+};
+
+// How the rules of a generation are made
+UENUM(BlueprintType)
+enum class EWFCModel : uint8
+{
+    // Tiles fit next to each other where their edge types are compatible
+    Tiled UMETA(DisplayName = "Tiled"),
+
+    // Every window of cells must look like a window of a sample texture or grid
+    Overlapping UMETA(DisplayName = "Overlapping")
+};
+
+// Algorithm used to propagate constraints after a cell is collapsed
+UENUM(BlueprintType)
+enum class EWFCPropagator : uint8
+{
+    // Re-derive each neighbor's allowed states from the full state set of the current cell
+    Bitmask UMETA(DisplayName = "Bitmask"),
+
+    // Track per-direction support counts and only propagate individual tile removals (AC-4)
+    SupportCount UMETA(DisplayName = "Support Count")
+};
+
+// How the collapsed grid is turned into meshes
+UENUM(BlueprintType)
+enum class EWFCOutputMode : uint8
+{
+    // One static mesh component per cell
+    StaticMeshComponents UMETA(DisplayName = "Static Mesh Components"),
+
+    // One instanced static mesh component per tile type
+    InstancedStaticMesh UMETA(DisplayName = "Instanced Static Mesh"),
+
+    // One hierarchical instanced static mesh component per tile type
+    HierarchicalInstancedStaticMesh UMETA(DisplayName = "Hierarchical Instanced Static Mesh")
+};
+
+// What a cell constraint does with the tile types it lists
+UENUM(BlueprintType)
+enum class EWFCCellConstraintType : uint8
+{
+    // The cells can only take one of the listed tiles; list a single tile to fix it in place
+    Allow UMETA(DisplayName = "Allow"),
+
+    // The cells can take any tile except the listed ones
+    Ban UMETA(DisplayName = "Ban")
+};
+
+// Side of the grid, in the order of the solver's directions
+UENUM(BlueprintType)
+enum class EWFCGridSide : uint8
+{
+    North UMETA(DisplayName = "North"),
+    East UMETA(DisplayName = "East"),
+    South UMETA(DisplayName = "South"),
+    West UMETA(DisplayName = "West"),
+    Top UMETA(DisplayName = "Top"),
+    Bottom UMETA(DisplayName = "Bottom")
+};
+
+// Structure to represent a tile type with its edge types
+USTRUCT(BlueprintType)
+struct WFC_API FTileType
+{
+    GENERATED_USTRUCT_BODY()
+
+    // The mesh to use for this tile
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Tile Properties")
+    UStaticMesh* Mesh;
+
+    // Relative likelihood of picking this tile when a cell is observed
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Tile Properties", meta=(ClampMin="0"))
+    float Weight;
+
+    // Edge types for each direction (North, East, South, West, Up, Down)
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Edge Types")
+    ETileEdgeType NorthEdge;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Edge Types")
+    ETileEdgeType EastEdge;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Edge Types")
+    ETileEdgeType SouthEdge;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Edge Types")
+    ETileEdgeType WestEdge;
+
+    // Faces touching the layers above and below; only used when the grid is more than one layer deep
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Edge Types")
+    ETileEdgeType UpEdge;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Edge Types")
+    ETileEdgeType DownEdge;
+
+    // Also use the tile turned by 90, 180 and 270 degrees around its pivot.
+    // Turns that end up with the same edges as another are dropped.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Symmetry")
+    bool bGenerateRotations;
+
+    // Also use the tile mirrored from east to west, and its turns when rotations are generated
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Symmetry")
+    bool bGenerateReflections;
+
+    FTileType()
+    {
+        Mesh = nullptr;
+        Weight = 1.f;
+        NorthEdge = ETileEdgeType::Type_A;
+        EastEdge = ETileEdgeType::Type_A;
+        SouthEdge = ETileEdgeType::Type_A;
+        WestEdge = ETileEdgeType::Type_A;
+        UpEdge = ETileEdgeType::Type_A;
+        DownEdge = ETileEdgeType::Type_A;
+        bGenerateRotations = false;
+        bGenerateReflections = false;
+    }
+};
+
+// Edge types one edge type can connect to, for edges that match more than one other edge
+USTRUCT(BlueprintType)
+struct WFC_API FEdgeCompatibility
+{
+    GENERATED_USTRUCT_BODY()
+
+    // The edge type this rule is for
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Edge Types")
+    ETileEdgeType Edge;
+
+    // Every edge type that can be placed against it
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Edge Types")
+    TArray<ETileEdgeType> CompatibleWith;
+
+    FEdgeCompatibility()
+    {
+        Edge = ETileEdgeType::Type_A;
+    }
+};
+
+// Tiles allowed or banned in a box of cells before the grid is solved
+USTRUCT(BlueprintType)
+struct WFC_API FWFCCellConstraint
+{
+    GENERATED_USTRUCT_BODY()
+
+    // First cell of the box (Z is the layer)
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Constraints")
+    FIntVector Cell;
+
+    // Number of cells the box covers along each axis from Cell
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Constraints", meta=(ClampMin="1"))
+    FIntVector Size;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Constraints")
+    EWFCCellConstraintType Type;
+
+    // Tile type indices the constraint allows or bans, with all their variants
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Constraints")
+    TArray<int32> Tiles;
+
+    // Quarter turns an allowed tile must have, -1 for any; ignored when banning
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Constraints", meta=(ClampMin="-1", ClampMax="3"))
+    int32 Rotation;
+
+    FWFCCellConstraint()
+    {
+        Cell = FIntVector::ZeroValue;
+        Size = FIntVector(1, 1, 1);
+        Type = EWFCCellConstraintType::Allow;
+        Rotation = -1;
+    }
+};
+
+// Edge type outside one side of the grid; the cells along that side must have an edge compatible with it there
+USTRUCT(BlueprintType)
+struct WFC_API FWFCBoundaryEdge
+{
+    GENERATED_USTRUCT_BODY()
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Constraints")
+    EWFCGridSide Side;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Constraints")
+    ETileEdgeType Edge;
+
+    FWFCBoundaryEdge()
+    {
+        Side = EWFCGridSide::North;
+        Edge = ETileEdgeType::Type_A;
+    }
+};
+
+// A region the server re-solved, replayed by clients in the same order
+USTRUCT()
+struct WFC_API FWFCReplicatedResolve
+{
+    GENERATED_USTRUCT_BODY()
+
+    // Cells of the region, Max exclusive, as clipped by ResolveRegion
+    UPROPERTY()
+    FIntPoint Min;
+
+    UPROPERTY()
+    FIntPoint Max;
+
+    // Resolve counter the region's seed was salted with
+    UPROPERTY()
+    int32 ResolveIndex;
+
+    FWFCReplicatedResolve()
+    {
+        Min = FIntPoint::ZeroValue;
+        Max = FIntPoint::ZeroValue;
+        ResolveIndex = 0;
+    }
+};
+
+// What clients need to rebuild the server's grid with their own solver, in place of the spawned tiles
+USTRUCT()
+struct WFC_API FWFCReplicatedGeneration
+{
+    GENERATED_USTRUCT_BODY()
+
+    // Raised by every full generation on the server; 0 until the first one
+    UPROPERTY()
+    int32 GenerationId;
+
+    UPROPERTY()
+    int32 Seed;
+
+    UPROPERTY()
+    int32 Width;
+
+    UPROPERTY()
+    int32 Height;
+
+    UPROPERTY()
+    int32 Depth;
+
+    // Hash of the compiled rules the grid was solved with
+    UPROPERTY()
+    uint64 RuleHash;
+
+    // Hash of the cell constraints and boundary edges, 0 without any
+    UPROPERTY()
+    uint64 ConstraintHash;
+
+    // Solver settings that change the grid, taken over by clients
+    UPROPERTY()
+    EWFCPropagator Propagator;
+
+    UPROPERTY()
+    int32 BacktrackDepth;
+
+    UPROPERTY()
+    int32 MaxBacktracks;
+
+    UPROPERTY()
+    int32 LocalRestartRadius;
+
+    UPROPERTY()
+    int32 MaxLocalRestarts;
+
+    // Side of the regions solved in parallel, 0 where the grid was solved in one piece
+    UPROPERTY()
+    int32 RegionSize;
+
+    // Result cache key of the grid before any resolve, for clients that can't solve it themselves
+    UPROPERTY()
+    uint64 CacheKey;
+
+    // CRC32 of the server's final states once every resolve is applied
+    UPROPERTY()
+    uint32 Checksum;
+
+    // Regions re-solved since the generation, oldest first
+    UPROPERTY()
+    TArray<FWFCReplicatedResolve> Resolves;
+
+    FWFCReplicatedGeneration()
+    {
+        GenerationId = 0;
+        Seed = 0;
+        Width = 0;
+        Height = 0;
+        Depth = 1;
+        RuleHash = 0;
+        ConstraintHash = 0;
+        Propagator = EWFCPropagator::Bitmask;
+        BacktrackDepth = 0;
+        MaxBacktracks = 0;
+        LocalRestartRadius = 0;
+        MaxLocalRestarts = 0;
+        RegionSize = 0;
+        CacheKey = 0;
+        Checksum = 0;
+    }
+};
+
+// Snapshot of a grid cell that can be collapsed to a specific tile type, built from the wave for inspection
+USTRUCT(BlueprintType)
+struct WFC_API FCell 
+{
+    GENERATED_USTRUCT_BODY()
+
+    // Possible states (tile types) this cell can have
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Cell Properties")
+    TArray<int32> PossibleStates;
+
+    // Is this cell collapsed to a single state?
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Cell Properties")
+    bool bIsCollapsed;
+
+    // The final state after collapse (tile type index)
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Cell Properties")
+    int32 FinalState;
+
+    // Quarter turns of the final tile, as a yaw of 90 degrees each
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Cell Properties")
+    int32 Rotation;
+
+    // Is the final tile mirrored from east to west?
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Cell Properties")
+    bool bReflected;
+
+    // Constructor with default values
+    FCell() 
+    {
+        bIsCollapsed = false;
+        FinalState = -1;
+        Rotation = 0;
+        bReflected = false;
+    }
+};
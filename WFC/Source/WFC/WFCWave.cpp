@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCWave.h"
+
+void FWFCWave::Init(int32 InNumCells, int32 InNumTiles)
+{
+    NumCells = InNumCells;
+    NumTiles = InNumTiles;
+    NumWords = FMath::DivideAndRoundUp(NumTiles, 64);
+
+    Bits.SetNumUninitialized(NumCells * NumWords, EAllowShrinking::No);
+    if (NumCells > 0)
+    {
+        // Build the full row in the first cell and stamp it into every other one
+        FMemory::Memzero(Bits.GetData(), NumWords * sizeof(uint64));
+        for (int32 Tile = 0; Tile < NumTiles; ++Tile)
+        {
+            WFCBits::Set(Bits.GetData(), Tile);
+        }
+
+        for (int32 Cell = 1; Cell < NumCells; ++Cell)
+        {
+            FMemory::Memcpy(&Bits[Cell * NumWords], Bits.GetData(), NumWords * sizeof(uint64));
+        }
+    }
+
+    Counts.SetNumUninitialized(NumCells, EAllowShrinking::No);
+    for (int32& Count : Counts)
+    {
+        Count = NumTiles;
+    }
+}
+
+void FWFCWave::ResetCell(int32 Cell)
+{
+    uint64* Row = &Bits[Cell * NumWords];
+    for (int32 Word = 0; Word < NumWords; ++Word)
+    {
+        // Every word is full except for the unused high bits of the last one
+        const int32 TilesInWord = FMath::Min(NumTiles - Word * 64, 64);
+        Row[Word] = TilesInWord == 64 ? ~0ull : (1ull << TilesInWord) - 1;
+    }
+    Counts[Cell] = NumTiles;
+}
+
+int32 FWFCWave::GetFirstState(int32 Cell) const
+{
+    const uint64* Row = GetRow(Cell);
+    for (int32 Word = 0; Word < NumWords; ++Word)
+    {
+        if (Row[Word])
+        {
+            return Word * 64 + static_cast<int32>(FMath::CountTrailingZeros64(Row[Word]));
+        }
+    }
+    return -1;
+}
+
+int32 FWFCWave::GetNthState(int32 Cell, int32 N) const
+{
+    const uint64* Row = GetRow(Cell);
+    for (int32 Word = 0; Word < NumWords; ++Word)
+    {
+        uint64 WordBits = Row[Word];
+        const int32 WordCount = FMath::CountBits(WordBits);
+        if (N >= WordCount)
+        {
+            N -= WordCount;
+            continue;
+        }
+
+        // Drop the lowest N set bits of this word
+        for (; N > 0; --N)
+        {
+            WordBits &= WordBits - 1;
+        }
+        return Word * 64 + static_cast<int32>(FMath::CountTrailingZeros64(WordBits));
+    }
+    return -1;
+}
+
+int32 FWFCWave::CountIntersection(int32 Cell, const uint64* Mask) const
+{
+    return WFCBits::DispatchKernels(NumWords, [this, Cell, Mask](auto Kernels)
+    {
+        return CountIntersection(Kernels, Cell, Mask);
+    });
+}
+
+int32 FWFCWave::Intersect(int32 Cell, const uint64* Mask)
+{
+    return WFCBits::DispatchKernels(NumWords, [this, Cell, Mask](auto Kernels)
+    {
+        return Intersect(Kernels, Cell, Mask);
+    });
+}
+
+void FWFCWave::Collapse(int32 Cell, int32 Tile)
+{
+    uint64* Row = &Bits[Cell * NumWords];
+    FMemory::Memzero(Row, NumWords * sizeof(uint64));
+    WFCBits::Set(Row, Tile);
+    Counts[Cell] = 1;
+}
+
+void FWFCWave::GetStates(int32 Cell, TArray<int32>& OutStates) const
+{
+    OutStates.Reset(Counts[Cell]);
+    WFCBits::ForEachSetBit(GetRow(Cell), NumWords, [&OutStates](int32 Tile)
+    {
+        OutStates.Add(Tile);
+    });
+}
@@ -0,0 +1,263 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if PLATFORM_ALWAYS_HAS_AVX_2
+#include <immintrin.h>
+#endif
+
+// Helpers for fixed-width bitsets stored as arrays of 64-bit words
+namespace WFCBits
+{
+    inline bool Test(const uint64* Words, int32 Bit)
+    {
+        return (Words[Bit >> 6] & (1ull << (Bit & 63))) != 0;
+    }
+
+    inline void Set(uint64* Words, int32 Bit)
+    {
+        Words[Bit >> 6] |= 1ull << (Bit & 63);
+    }
+
+    inline void Clear(uint64* Words, int32 Bit)
+    {
+        Words[Bit >> 6] &= ~(1ull << (Bit & 63));
+    }
+
+    inline int32 Count(const uint64* Words, int32 NumWords)
+    {
+        int32 Total = 0;
+        for (int32 Word = 0; Word < NumWords; ++Word)
+        {
+            Total += FMath::CountBits(Words[Word]);
+        }
+        return Total;
+    }
+
+    // Call Func with the index of every set bit, in ascending order
+    template <typename FuncType>
+    void ForEachSetBit(const uint64* Words, int32 NumWords, FuncType&& Func)
+    {
+        for (int32 Word = 0; Word < NumWords; ++Word)
+        {
+            uint64 Bits = Words[Word];
+            while (Bits)
+            {
+                Func(Word * 64 + static_cast<int32>(FMath::CountTrailingZeros64(Bits)));
+                Bits &= Bits - 1;
+            }
+        }
+    }
+
+    // Dst |= Src and Dst &= Src on two words at once, through UE's 128-bit integer vectors when the platform has them
+    FORCEINLINE void Or2(uint64* Dst, const uint64* Src)
+    {
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+        VectorIntStore(VectorIntOr(VectorIntLoad(Dst), VectorIntLoad(Src)), Dst);
+#else
+        Dst[0] |= Src[0];
+        Dst[1] |= Src[1];
+#endif
+    }
+
+    FORCEINLINE void And2(uint64* Dst, const uint64* Src)
+    {
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+        VectorIntStore(VectorIntAnd(VectorIntLoad(Dst), VectorIntLoad(Src)), Dst);
+#else
+        Dst[0] &= Src[0];
+        Dst[1] &= Src[1];
+#endif
+    }
+
+    // The same on four words, in a single 256-bit register on targets built with AVX2
+    FORCEINLINE void Or4(uint64* Dst, const uint64* Src)
+    {
+#if PLATFORM_ALWAYS_HAS_AVX_2
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(Dst), _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(Dst)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Src))));
+#else
+        Or2(Dst, Src);
+        Or2(Dst + 2, Src + 2);
+#endif
+    }
+
+    FORCEINLINE void And4(uint64* Dst, const uint64* Src)
+    {
+#if PLATFORM_ALWAYS_HAS_AVX_2
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(Dst), _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(Dst)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Src))));
+#else
+        And2(Dst, Src);
+        And2(Dst + 2, Src + 2);
+#endif
+    }
+
+    // The bitset operations of the propagation loop for rows of NumWordsT words.
+    // With the word count known at compile time the loops below fold into straight-line vector code;
+    // NumWordsT of 0 is the fallback that reads the count at runtime.
+    // Counting stays on 64-bit words, where FMath::CountBits is a single popcnt / cnt instruction.
+    template <int32 NumWordsT>
+    struct TKernels
+    {
+        static FORCEINLINE int32 GetNumWords(int32 NumWords) { return NumWordsT > 0 ? NumWordsT : NumWords; }
+
+        static FORCEINLINE void Zero(uint64* Dst, int32 NumWords)
+        {
+            FMemory::Memzero(Dst, GetNumWords(NumWords) * sizeof(uint64));
+        }
+
+        // Dst |= Src
+        static FORCEINLINE void Or(uint64* RESTRICT Dst, const uint64* RESTRICT Src, int32 NumWords)
+        {
+            const int32 N = GetNumWords(NumWords);
+            int32 Word = 0;
+            for (; Word + 4 <= N; Word += 4)
+            {
+                Or4(Dst + Word, Src + Word);
+            }
+            if (Word + 2 <= N)
+            {
+                Or2(Dst + Word, Src + Word);
+                Word += 2;
+            }
+            if (Word < N)
+            {
+                Dst[Word] |= Src[Word];
+            }
+        }
+
+        // Dst &= Src, returning the number of bits left in Dst
+        static FORCEINLINE int32 AndCount(uint64* RESTRICT Dst, const uint64* RESTRICT Src, int32 NumWords)
+        {
+            const int32 N = GetNumWords(NumWords);
+            int32 Word = 0;
+            for (; Word + 4 <= N; Word += 4)
+            {
+                And4(Dst + Word, Src + Word);
+            }
+            if (Word + 2 <= N)
+            {
+                And2(Dst + Word, Src + Word);
+                Word += 2;
+            }
+            if (Word < N)
+            {
+                Dst[Word] &= Src[Word];
+            }
+            return Count(Dst, N);
+        }
+
+        // Number of bits set in both A and B
+        static FORCEINLINE int32 CountAnd(const uint64* A, const uint64* B, int32 NumWords)
+        {
+            const int32 N = GetNumWords(NumWords);
+            int32 Total = 0;
+            for (int32 Word = 0; Word < N; ++Word)
+            {
+                Total += FMath::CountBits(A[Word] & B[Word]);
+            }
+            return Total;
+        }
+    };
+
+    // Call Func with the kernels for a word count: specialised for the common tile set sizes
+    // of up to 64, 128 and 256 tiles, the runtime loop for anything else
+    template <typename FuncType>
+    FORCEINLINE decltype(auto) DispatchKernels(int32 NumWords, FuncType&& Func)
+    {
+        switch (NumWords)
+        {
+        case 1: return Func(TKernels<1>());
+        case 2: return Func(TKernels<2>());
+        case 4: return Func(TKernels<4>());
+        default: return Func(TKernels<0>());
+        }
+    }
+}
+
+// Dense storage for the possible states of every cell.
+// Each cell owns one fixed-width bitset row in a single contiguous buffer,
+// with its popcount cached in a parallel array.
+struct WFC_API FWFCWave
+{
+    // Allocate the rows and put every cell in full superposition
+    void Init(int32 InNumCells, int32 InNumTiles);
+
+    int32 GetNumCells() const { return NumCells; }
+    int32 GetNumTiles() const { return NumTiles; }
+    int32 GetNumWords() const { return NumWords; }
+
+    // Bitset of the states a cell can still take
+    const uint64* GetRow(int32 Cell) const { return &Bits[Cell * NumWords]; }
+
+    // Number of states a cell can still take
+    int32 GetCount(int32 Cell) const { return Counts[Cell]; }
+
+    // A cell with one state left is collapsed
+    bool IsCollapsed(int32 Cell) const { return Counts[Cell] == 1; }
+
+    bool Contains(int32 Cell, int32 Tile) const { return WFCBits::Test(GetRow(Cell), Tile); }
+
+    // Lowest state still possible in the cell, or -1 if none
+    int32 GetFirstState(int32 Cell) const;
+
+    // The N-th possible state of the cell in ascending order, or -1 if out of range
+    int32 GetNthState(int32 Cell, int32 N) const;
+
+    // Number of states that would remain after intersecting the cell with Mask
+    int32 CountIntersection(int32 Cell, const uint64* Mask) const;
+
+    // Intersect the cell with Mask and return the number of states left
+    int32 Intersect(int32 Cell, const uint64* Mask);
+
+    // The same with kernels already picked for the word count, for loops that dispatch once up front
+    template <typename KernelsType>
+    int32 CountIntersection(KernelsType Kernels, int32 Cell, const uint64* Mask) const
+    {
+        return Kernels.CountAnd(GetRow(Cell), Mask, NumWords);
+    }
+
+    template <typename KernelsType>
+    int32 Intersect(KernelsType Kernels, int32 Cell, const uint64* Mask)
+    {
+        return Counts[Cell] = Kernels.AndCount(&Bits[Cell * NumWords], Mask, NumWords);
+    }
+
+    // Reduce the cell to a single state
+    void Collapse(int32 Cell, int32 Tile);
+
+    // Remove one state from the cell and return the number of states left
+    int32 Ban(int32 Cell, int32 Tile)
+    {
+        WFCBits::Clear(&Bits[Cell * NumWords], Tile);
+        return --Counts[Cell];
+    }
+
+    // Put back a state removed by Ban or Intersect and return the number of states
+    int32 Unban(int32 Cell, int32 Tile)
+    {
+        WFCBits::Set(&Bits[Cell * NumWords], Tile);
+        return ++Counts[Cell];
+    }
+
+    // Put a single cell back in full superposition
+    void ResetCell(int32 Cell);
+
+    // Heap memory held by the rows and counts
+    SIZE_T GetAllocatedSize() const { return Bits.GetAllocatedSize() + Counts.GetAllocatedSize(); }
+
+    // Copy the possible states of the cell into an index list
+    void GetStates(int32 Cell, TArray<int32>& OutStates) const;
+
+private:
+    int32 NumCells = 0;
+    int32 NumTiles = 0;
+    int32 NumWords = 0;
+
+    // NumCells rows of NumWords each
+    TArray<uint64> Bits;
+
+    // Cached popcount of each row
+    TArray<int32> Counts;
+};
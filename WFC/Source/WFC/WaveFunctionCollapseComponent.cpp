@@ -2,7 +2,21 @@
 
 
 #include "WaveFunctionCollapseComponent.h"
+#include "WFCResultCache.h"
+#include "WFCOverlappingModel.h"
+#include "WFCStats.h"
+#include "WFCSolverPool.h"
 #include "Engine/World.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/Texture2D.h"
+#include "TextureResource.h"
+#include "Hash/CityHash.h"
+#include "Misc/Crc.h"
+#include "Net/UnrealNetwork.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Async/Async.h"
+#include "Tasks/Task.h"
 
 // Sets default values for this component's properties
 UWaveFunctionCollapseComponent::UWaveFunctionCollapseComponent()
@@ -11,6 +25,9 @@ UWaveFunctionCollapseComponent::UWaveFunctionCollapseComponent()
     // off to improve performance if you don't need them.
     PrimaryComponentTick.bCanEverTick = true;
 
+    // Ticking is only needed while a time sliced generation runs
+    PrimaryComponentTick.bStartWithTickEnabled = false;
+
     // Initialize default edge compatibility
     CompatibleEdges.Add(ETileEdgeType::Type_A, ETileEdgeType::Type_A);
     CompatibleEdges.Add(ETileEdgeType::Type_B, ETileEdgeType::Type_B);
@@ -25,7 +42,37 @@ void UWaveFunctionCollapseComponent::BeginPlay()
     Super::BeginPlay();
 
     ValidateEdgeRules();
-    GenerateGrid();
+
+    if (bReplicateGeneration)
+    {
+        SetIsReplicated(true);
+    }
+
+    // Clients wait for the server's description instead, which may already be here
+    if (IsReplicatedClient())
+    {
+        ApplyReplicatedGeneration();
+    }
+    else if (bGenerateOnBeginPlay)
+    {
+        GenerateGrid();
+    }
+}
+
+
+// Called when the component is removed from play
+void UWaveFunctionCollapseComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    CancelGeneration();
+
+    Super::EndPlay(EndPlayReason);
+}
+
+void UWaveFunctionCollapseComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+    Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+    DOREPLIFETIME(UWaveFunctionCollapseComponent, ReplicatedGeneration);
 }
 
 
@@ -33,445 +80,1696 @@ void UWaveFunctionCollapseComponent::BeginPlay()
 void UWaveFunctionCollapseComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
     Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+    if (bTimeSlicing)
+    {
+        TickTimeSlice();
+    }
 }
 
 void UWaveFunctionCollapseComponent::GenerateGrid()
 {
-    // Validate edge rules before generating
-    if (!ValidateEdgeRules())
-    {
-        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse failed: Invalid edge compatibility rules"));
+    TRACE_CPUPROFILER_EVENT_SCOPE(WFC_GenerateGrid);
+    SCOPE_CYCLE_COUNTER(STAT_WFC_GenerateGrid);
+
+    // A synchronous generation replaces any asynchronous one still running
+    CancelGeneration();
+
+    if (!CompileRules())
         return;
-    }
 
-    // Initialize grid
-    Grid.Empty();
-    Grid.SetNum(GridWidth * GridHeight);
+    PickSeed();
 
-    // Set all cells to have all possible states initially
-    for (FCell& Cell : Grid)
+    // Time sliced solves step a single solver, so they never split the grid into regions
+    const int32 RegionSize = bTimeSliced ? 0 : GetParallelRegionSize();
+    if (SpawnCachedResult(RegionSize))
+        return;
+
+    Solver.SetRecordCollapses(bTimeSliced && bSpawnIncrementally);
+
+    if (bTimeSliced)
     {
-        Cell.bIsCollapsed = false;
-        Cell.PossibleStates.Empty();
+        Solver.Init(CompiledRules.ToSharedRef(), MakeSolverSettings());
 
-        // Add all tile types as possible states
-        for (int32 i = 0; i < TileTypes.Num(); ++i)
+        // Only set up the wave now; the solve itself runs from TickComponent
+        FinalStates.Init(-1, Solver.GetNumCells());
+        FinalRules = CompiledRules;
+        if (bSpawnIncrementally)
         {
-            Cell.PossibleStates.Add(i);
+            // Tiles appear as their cells collapse, so start from an empty grid
+            SpawnTileMeshes();
         }
+        bTimeSlicing = true;
+        SetComponentTickEnabled(true);
+        return;
     }
 
-    // Run the WFC algorithm until the grid is fully collapsed
-    int32 MaxIterations = GridWidth * GridHeight * 10; // Safety limit to prevent infinite loops
-    int32 IterationCount = 0;
+    EWFCSolveStatus Status = RunSolve(Solver, CompiledRules.ToSharedRef(), MakeSolverSettings(), RegionSize);
+    Solver.GetFinalStates(FinalStates);
+    FinalRules = CompiledRules;
 
-    while (!IsGridFullyCollapsed() && IterationCount < MaxIterations)
-    {
-        // Find the cell with the lowest entropy
-        int32 CellToCollapse = FindCellWithLowestEntropy();
+    FinishGeneration(Status, Solver.GetMaxIterations());
+}
+
+void UWaveFunctionCollapseComponent::GenerateGridAsync()
+{
+    // A cached grid is spawned straight away, so OnGenerationComplete fires before this returns
+    FWFCSolverSettings Settings;
+    int32 RegionSize = 0;
+    bool bCompleted = false;
+    FGenerationHandle Generation = BeginAsyncGeneration(Settings, RegionSize, bCompleted);
+    if (!Generation)
+        return;
+
+    FWFCSolver::FRulesRef Rules = CompiledRules.ToSharedRef();
+    TWeakObjectPtr<UWaveFunctionCollapseComponent> WeakThis(this);
 
-        if (CellToCollapse == -1)
-            break;  // No valid cells left to collapse
+    UE::Tasks::Launch(UE_SOURCE_LOCATION, [WeakThis, Generation, Rules, Settings, RegionSize]()
+    {
+        // Solve against the rule snapshot taken when the generation was started, in a pooled solver
+        FWFCSolverPool::FScopedSolver AsyncSolver;
+        EWFCSolveStatus Status = RunSolve(*AsyncSolver, Rules, Settings, RegionSize, &Generation->bCancelled);
+        if (Status == EWFCSolveStatus::Cancelled)
+            return;
+
+        // Only the tile indices go back to the game thread
+        TArray<int32> States;
+        AsyncSolver->GetFinalStates(States);
+        const int32 MaxIterations = AsyncSolver->GetMaxIterations();
+
+        AsyncTask(ENamedThreads::GameThread, [WeakThis, Generation, Status, MaxIterations, States = MoveTemp(States)]() mutable
+        {
+            if (UWaveFunctionCollapseComponent* This = WeakThis.Get())
+            {
+                This->FinishAsyncGeneration(Generation, Status, MaxIterations, MoveTemp(States));
+            }
+        });
+    });
+}
 
-        // Collapse the cell
-        CollapseCell(CellToCollapse);
+UWaveFunctionCollapseComponent::FGenerationHandle UWaveFunctionCollapseComponent::BeginAsyncGeneration(FWFCSolverSettings& OutSettings, int32& OutRegionSize, bool& bOutCompleted)
+{
+    bOutCompleted = false;
+    CancelGeneration();
 
-        // Propagate constraints
-        PropagateConstraints(CellToCollapse);
+    if (!CompileRules())
+        return nullptr;
 
-        IterationCount++;
-    }
+    // The worker owns its own wave, so drop the one from the last synchronous run
+    Solver.Clear();
+    PickSeed();
 
-    if (IterationCount >= MaxIterations)
+    // Solves off the game thread aren't time sliced, so they always use the parallel regions
+    OutRegionSize = GetParallelRegionSize();
+    if (SpawnCachedResult(OutRegionSize))
     {
-        UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse reached max iterations (%d). Grid may be incomplete."), MaxIterations);
+        bOutCompleted = true;
+        return nullptr;
     }
 
-    // Spawn the meshes
-    SpawnTileMeshes();
+    FGenerationHandle Generation = MakeShared<FAsyncGeneration, ESPMode::ThreadSafe>();
+    Generation->Rules = CompiledRules;
+    PendingGeneration = Generation;
+    OutSettings = MakeSolverSettings();
+    return Generation;
 }
 
-int32 UWaveFunctionCollapseComponent::FindCellWithLowestEntropy()
+bool UWaveFunctionCollapseComponent::FinishAsyncGeneration(const FGenerationHandle& Generation, EWFCSolveStatus Status, int32 MaxIterations, TArray<int32>&& States, bool bReproducible)
 {
-    int32 LowestEntropyIndex = -1;
-    int32 LowestEntropy = TNumericLimits<int32>::Max();
+    if (!Generation || PendingGeneration != Generation || Generation->bCancelled)
+        return false;
+
+    PendingGeneration.Reset();
+    FinalStates = MoveTemp(States);
+    FinalRules = Generation->Rules;
+    FinishGeneration(Status, MaxIterations, bReproducible);
+    return true;
+}
+
+void UWaveFunctionCollapseComponent::TickTimeSlice()
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(WFC_TickTimeSlice);
+    SCOPE_CYCLE_COUNTER(STAT_WFC_Solve);
+
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+    const double BudgetSeconds = TimeSliceBudgetMicroseconds * 1e-6;
+
+    // Always make some progress, even with a tiny budget
+    EWFCSolveStatus Status;
+    do
+    {
+        Status = Solver.Step();
+    }
+    while (Status == EWFCSolveStatus::Running && FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles) < BudgetSeconds);
 
-    // Find uncollapsed cell with fewest possible states
-    for (int32 i = 0; i < Grid.Num(); ++i)
+    if (bSpawnIncrementally)
     {
-        const FCell& Cell = Grid[i];
+        // Show the tiles of the cells that collapsed during this slice
+        Solver.ConsumeNewlyCollapsed(CollapsedCells);
 
-        if (!Cell.bIsCollapsed && Cell.PossibleStates.Num() > 0)
+        const bool bCanSpawn = GetWorld() != nullptr;
+        const FVector Origin = GetOwner()->GetActorLocation();
+
+        for (int32 CellIndex : CollapsedCells)
         {
-            if (Cell.PossibleStates.Num() < LowestEntropy)
+            FinalStates[CellIndex] = Solver.GetCellState(CellIndex);
+            if (bCanSpawn)
             {
-                LowestEntropy = Cell.PossibleStates.Num();
-                LowestEntropyIndex = i;
+                SpawnTile(CellIndex, Origin);
             }
         }
     }
 
-    return LowestEntropyIndex;
-}
-
-void UWaveFunctionCollapseComponent::CollapseCell(int32 CellIndex)
-{
-    if (CellIndex < 0 || CellIndex >= Grid.Num())
+    if (Status == EWFCSolveStatus::Running)
         return;
 
-    FCell& Cell = Grid[CellIndex];
-
-    if (Cell.bIsCollapsed || Cell.PossibleStates.Num() == 0)
-        return;
+    bTimeSlicing = false;
+    SetComponentTickEnabled(false);
 
-    // Choose a random state from the possible states
-    int32 RandomIndex = FMath::RandRange(0, Cell.PossibleStates.Num() - 1);
-    int32 ChosenState = Cell.PossibleStates[RandomIndex];
+    // Cells undone by backtracking may still show a tile they no longer have; the diff in FinishGeneration fixes them up
+    Solver.GetFinalStates(FinalStates);
+    FinishGeneration(Status, Solver.GetMaxIterations());
+}
 
-    // Collapse the cell to this state
-    Cell.PossibleStates.Empty();
-    Cell.PossibleStates.Add(ChosenState);
-    Cell.FinalState = ChosenState;
-    Cell.bIsCollapsed = true;
+void UWaveFunctionCollapseComponent::ClearGrid()
+{
+    ReleaseAllTiles();
 }
 
-void UWaveFunctionCollapseComponent::PropagateConstraints(int32 CellIndex)
+bool UWaveFunctionCollapseComponent::ResolveRegion(FIntRect Region)
 {
-    if (CellIndex < 0 || CellIndex >= Grid.Num())
-        return;
+    TRACE_CPUPROFILER_EVENT_SCOPE(WFC_ResolveRegion);
+    SCOPE_CYCLE_COUNTER(STAT_WFC_Solve);
 
-    // Create a queue for propagation
-    TArray<int32> PropagationQueue;
-    PropagationQueue.Add(CellIndex);
+    if (IsGenerating())
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse can't re-solve a region while a generation is running"));
+        return false;
+    }
 
-    // Process the queue
-    while (PropagationQueue.Num() > 0)
+    if (FinalStates.Num() != GetNumCells())
     {
-        int32 CurrentCellIndex = PropagationQueue[0];
-        PropagationQueue.RemoveAt(0);
+        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse has no generated grid of the current size to re-solve"));
+        return false;
+    }
 
-        int32 X, Y;
-        IndexToXY(CurrentCellIndex, X, Y);
+    Region.Clip(FIntRect(0, 0, GridWidth, GridHeight));
+    if (Region.Width() <= 0 || Region.Height() <= 0)
+        return false;
 
-        const FCell& CurrentCell = Grid[CurrentCellIndex];
+    // The kept tiles are indices into the rules they were solved with, so the region is solved with those too.
+    // Rules built from the current tile set must match them, or the kept tiles would read as other variants.
+    const TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> CurrentRules = BuildRules();
+    if (!CurrentRules || !FinalRules || CurrentRules->GetHash() != FinalRules->GetHash())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse tile rules changed since the grid was generated; regenerate it before re-solving a region"));
+        return false;
+    }
 
-        // Process North neighbor
-        if (Y > 0)
-        {
-            int32 NorthIndex = XYToIndex(X, Y - 1);
+    // Spawning reads the tiles through CompiledRules, and the constraints are compiled for it
+    CompiledRules = FinalRules;
+    if (!CompileConstraints())
+        return false;
 
-            // Get allowed north neighbors for current cell's possible states
-            TArray<int32> AllowedStatesForNorth;
+    // Solve the region as a grid of its own, so the cost only depends on its area. It spans every layer.
+    FWFCSolverSettings Settings = MakeSolverSettings();
+    Settings.Width = Region.Width();
+    Settings.Height = Region.Height();
+    const int32 ResolveIndex = NumRegionResolves++;
+    Settings.Seed = FWFCSolver::DeriveSeed(Seed, HashCombine(HashCombine(GetTypeHash(Region.Min), GetTypeHash(Region.Max)), ResolveIndex));
 
-            for (int32 StateIndex : CurrentCell.PossibleStates)
-            {
-                // Get the north edge type of the current tile
-                ETileEdgeType CurrentNorthEdge = TileTypes[StateIndex].NorthEdge;
+    // The initial constraints inside the region still hold
+    if (InitialConstraints)
+    {
+        TSharedRef<FWFCInitialConstraints, ESPMode::ThreadSafe> RegionConstraints = MakeShared<FWFCInitialConstraints, ESPMode::ThreadSafe>();
+        InitialConstraints->ExtractBox(GridWidth, GridHeight, FIntVector(Region.Min.X, Region.Min.Y, 0), FIntVector(Settings.Width, Settings.Height, GridDepth), *RegionConstraints);
+        Settings.Constraints = RegionConstraints;
+    }
 
-                // Find all tiles that have a compatible south edge
-                for (int32 i = 0; i < TileTypes.Num(); ++i)
-                {
-                    ETileEdgeType PotentialSouthEdge = TileTypes[i].SouthEdge;
-                    if (AreEdgesCompatible(CurrentNorthEdge, PotentialSouthEdge))
-                    {
-                        AllowedStatesForNorth.AddUnique(i);
-                    }
-                }
-            }
+    FWFCSolverPool::FScopedSolver RegionSolver;
+    RegionSolver->Init(CompiledRules.ToSharedRef(), Settings);
 
-            // Update the neighbor's possible states based on constraint
-            if (UpdateCellPossibilities(NorthIndex, AllowedStatesForNorth))
-            {
-                PropagationQueue.AddUnique(NorthIndex);
-            }
-        }
+    const int32 NumWords = CompiledRules->GetNumWords();
+    const int32 NumTiles = CompiledRules->GetNumTiles();
+    TArray<uint64, TInlineAllocator<4>> AllowedMask;
+    AllowedMask.SetNumUninitialized(NumWords);
 
-        // Process East neighbor
-        if (X < GridWidth - 1)
+    // Constrain the cells along the region border by the tiles kept just outside it.
+    // The region spans every layer, so only its sides have neighbors outside it.
+    for (int32 Z = 0; Z < GridDepth; ++Z)
+    {
+        for (int32 Y = Region.Min.Y; Y < Region.Max.Y; ++Y)
         {
-            int32 EastIndex = XYToIndex(X + 1, Y);
-
-            // Get allowed east neighbors for current cell's possible states
-            TArray<int32> AllowedStatesForEast;
-
-            for (int32 StateIndex : CurrentCell.PossibleStates)
+            for (int32 X = Region.Min.X; X < Region.Max.X; ++X)
             {
-                // Get the east edge type of the current tile
-                ETileEdgeType CurrentEastEdge = TileTypes[StateIndex].EastEdge;
-
-                // Find all tiles that have a compatible west edge
-                for (int32 i = 0; i < TileTypes.Num(); ++i)
+                FMemory::Memzero(AllowedMask.GetData(), NumWords * sizeof(uint64));
+                for (int32 Tile = 0; Tile < NumTiles; ++Tile)
                 {
-                    ETileEdgeType PotentialWestEdge = TileTypes[i].WestEdge;
-                    if (AreEdgesCompatible(CurrentEastEdge, PotentialWestEdge))
-                    {
-                        AllowedStatesForEast.AddUnique(i);
-                    }
+                    WFCBits::Set(AllowedMask.GetData(), Tile);
                 }
-            }
 
-            // Update the neighbor's possible states based on constraint
-            if (UpdateCellPossibilities(EastIndex, AllowedStatesForEast))
-            {
-                PropagationQueue.AddUnique(EastIndex);
-            }
-        }
-
-        // Process South neighbor
-        if (Y < GridHeight - 1)
-        {
-            int32 SouthIndex = XYToIndex(X, Y + 1);
-
-            // Get allowed south neighbors for current cell's possible states
-            TArray<int32> AllowedStatesForSouth;
-
-            for (int32 StateIndex : CurrentCell.PossibleStates)
-            {
-                // Get the south edge type of the current tile
-                ETileEdgeType CurrentSouthEdge = TileTypes[StateIndex].SouthEdge;
-
-                // Find all tiles that have a compatible north edge
-                for (int32 i = 0; i < TileTypes.Num(); ++i)
+                bool bConstrained = false;
+                for (int32 Dir = 0; Dir < FWFCCompiledRules::NumHorizontalDirections; ++Dir)
                 {
-                    ETileEdgeType PotentialNorthEdge = TileTypes[i].NorthEdge;
-                    if (AreEdgesCompatible(CurrentSouthEdge, PotentialNorthEdge))
+                    const FIntVector Offset = FWFCCompiledRules::GetOffset(static_cast<EWFCDirection>(Dir));
+                    const FIntPoint Neighbor(X + Offset.X, Y + Offset.Y);
+                    if (Region.Contains(Neighbor) || Neighbor.X < 0 || Neighbor.X >= GridWidth || Neighbor.Y < 0 || Neighbor.Y >= GridHeight)
+                        continue;
+
+                    const int32 NeighborState = FinalStates[XYZToIndex(Neighbor.X, Neighbor.Y, Z)];
+                    if (NeighborState < 0 || NeighborState >= NumTiles)
+                        continue;
+
+                    // The tiles the neighbor allows on its side facing this cell
+                    const EWFCDirection Back = FWFCCompiledRules::GetOppositeDirection(static_cast<EWFCDirection>(Dir));
+                    const uint64* NeighborAllows = CompiledRules->GetAllowedNeighbors(NeighborState, Back);
+                    for (int32 Word = 0; Word < NumWords; ++Word)
                     {
-                        AllowedStatesForSouth.AddUnique(i);
+                        AllowedMask[Word] &= NeighborAllows[Word];
                     }
+                    bConstrained = true;
                 }
-            }
-
-            // Update the neighbor's possible states based on constraint
-            if (UpdateCellPossibilities(SouthIndex, AllowedStatesForSouth))
-            {
-                PropagationQueue.AddUnique(SouthIndex);
-            }
-        }
-
-        // Process West neighbor
-        if (X > 0)
-        {
-            int32 WestIndex = XYToIndex(X - 1, Y);
 
-            // Get allowed west neighbors for current cell's possible states
-            TArray<int32> AllowedStatesForWest;
-
-            for (int32 StateIndex : CurrentCell.PossibleStates)
-            {
-                // Get the west edge type of the current tile
-                ETileEdgeType CurrentWestEdge = TileTypes[StateIndex].WestEdge;
-
-                // Find all tiles that have a compatible east edge
-                for (int32 i = 0; i < TileTypes.Num(); ++i)
+                // Kept on restart, so a local restart inside the region still fits the surroundings
+                if (bConstrained && !RegionSolver->ConstrainCell(RegionSolver->XYZToIndex(X - Region.Min.X, Y - Region.Min.Y, Z), AllowedMask.GetData(), true))
                 {
-                    ETileEdgeType PotentialEastEdge = TileTypes[i].EastEdge;
-                    if (AreEdgesCompatible(CurrentWestEdge, PotentialEastEdge))
-                    {
-                        AllowedStatesForWest.AddUnique(i);
-                    }
+                    UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse found no tile that fits the surroundings of cell (%d, %d, %d)"), X, Y, Z);
+                    return false;
                 }
             }
-
-            // Update the neighbor's possible states based on constraint
-            if (UpdateCellPossibilities(WestIndex, AllowedStatesForWest))
-            {
-                PropagationQueue.AddUnique(WestIndex);
-            }
         }
     }
-}
 
-bool UWaveFunctionCollapseComponent::UpdateCellPossibilities(int32 CellIndex, const TArray<int32>& AllowedStates)
-{
-    if (CellIndex < 0 || CellIndex >= Grid.Num())
+    RegionSolver->PropagatePendingConstraints();
+
+    const EWFCSolveStatus Status = RegionSolver->Run();
+    if (Status != EWFCSolveStatus::Completed)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse could not re-solve the region; the grid was left as it was"));
         return false;
+    }
 
-    FCell& Cell = Grid[CellIndex];
+    TArray<int32> RegionStates;
+    RegionSolver->GetFinalStates(RegionStates);
 
-    if (Cell.bIsCollapsed)
-        return false;
+    for (int32 i = 0; i < RegionStates.Num(); ++i)
+    {
+        int32 X, Y, Z;
+        RegionSolver->IndexToXYZ(i, X, Y, Z);
+        FinalStates[XYZToIndex(Region.Min.X + X, Region.Min.Y + Y, Z)] = RegionStates[i];
+    }
 
-    int32 PreviousCount = Cell.PossibleStates.Num();
+    // The wave of the last full solve no longer matches, so GetCell reads the final tiles
+    Solver.Clear();
 
-    // Create a filtered list of possible states based on constraints
-    TArray<int32> NewPossibleStates;
+    RecordReplicatedResolve(Region, ResolveIndex);
 
-    for (int32 State : Cell.PossibleStates)
+    UWorld* World = GetWorld();
+    if (!World)
+        return true;
+
+    const FVector Origin = GetOwner()->GetActorLocation();
+    if (!PrepareSpawnedTiles(Origin))
     {
-        if (AllowedStates.Contains(State))
-        {
-            NewPossibleStates.Add(State);
-        }
+        // Nothing of the old layout is left to diff against
+        SpawnTileMeshes();
+        return true;
     }
 
-    // Update the cell's possible states if the new list isn't empty
-    if (NewPossibleStates.Num() > 0)
+    for (int32 Z = 0; Z < GridDepth; ++Z)
     {
-        Cell.PossibleStates = NewPossibleStates;
-
-        // If the cell now has only one possible state, collapse it
-        if (Cell.PossibleStates.Num() == 1)
+        for (int32 Y = Region.Min.Y; Y < Region.Max.Y; ++Y)
         {
-            Cell.FinalState = Cell.PossibleStates[0];
-            Cell.bIsCollapsed = true;
+            for (int32 X = Region.Min.X; X < Region.Max.X; ++X)
+            {
+                SpawnTile(XYZToIndex(X, Y, Z), Origin);
+            }
         }
     }
 
-    // Return true if the possible states changed
-    return PreviousCount != Cell.PossibleStates.Num();
+    return true;
 }
 
-bool UWaveFunctionCollapseComponent::AreEdgesCompatible(ETileEdgeType Edge1, ETileEdgeType Edge2)
+void UWaveFunctionCollapseComponent::CancelGeneration()
 {
-    // If this edge type has a defined compatible edge, check against it
-    if (const ETileEdgeType* CompatibleEdge = CompatibleEdges.Find(Edge1))
+    if (PendingGeneration)
     {
-        return *CompatibleEdge == Edge2;
+        PendingGeneration->bCancelled = true;
+        PendingGeneration.Reset();
     }
 
-    return false;
+    if (bTimeSlicing)
+    {
+        bTimeSlicing = false;
+        SetComponentTickEnabled(false);
+    }
 }
 
-TArray<int32> UWaveFunctionCollapseComponent::GetTilesWithEdgeType(ETileEdgeType EdgeType, const FString& Direction)
+bool UWaveFunctionCollapseComponent::IsGenerating() const
 {
-    TArray<int32> MatchingTiles;
+    return PendingGeneration.IsValid() || bTimeSlicing;
+}
 
-    for (int32 i = 0; i < TileTypes.Num(); ++i)
-    {
-        const FTileType& Tile = TileTypes[i];
+float UWaveFunctionCollapseComponent::GetGenerationProgress() const
+{
+    if (bTimeSlicing)
+        return Solver.GetProgress() * 100.f;
 
-        if (Direction == "North" && Tile.NorthEdge == EdgeType)
-            MatchingTiles.Add(i);
-        else if (Direction == "East" && Tile.EastEdge == EdgeType)
-            MatchingTiles.Add(i);
-        else if (Direction == "South" && Tile.SouthEdge == EdgeType)
-            MatchingTiles.Add(i);
-        else if (Direction == "West" && Tile.WestEdge == EdgeType)
-            MatchingTiles.Add(i);
-    }
+    // Asynchronous solves don't report progress until they are done
+    return IsGenerating() ? 0.f : 100.f;
+}
 
-    return MatchingTiles;
+bool UWaveFunctionCollapseComponent::CompileRules()
+{
+    TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> Rules = BuildRules();
+    if (!Rules)
+        return false;
+
+    CompiledRules = Rules;
+    return CompileConstraints();
 }
 
-bool UWaveFunctionCollapseComponent::ValidateEdgeRules()
+TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> UWaveFunctionCollapseComponent::BuildRules()
 {
-    if (TileTypes.Num() == 0)
+    if (Model == EWFCModel::Overlapping)
+        return BuildOverlappingRules();
+
+    // Validate edge rules before generating
+    if (!ValidateEdgeRules())
     {
-        UE_LOG(LogTemp, Warning, TEXT("No tile types defined"));
-        return false;
+        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse failed: Invalid edge compatibility rules"));
+        return nullptr;
     }
 
-    bool bRulesAreValid = true;
+    // Compile the adjacency table once so propagation doesn't have to compare edges
+    TSharedRef<FWFCCompiledRules, ESPMode::ThreadSafe> Rules = MakeShared<FWFCCompiledRules, ESPMode::ThreadSafe>();
+    Rules->Compile(TileTypes, MakeEdgeMatrix());
+    return Rules;
+}
 
-    // Check that all edge types have compatibility rules
-    for (int32 i = 0; i < TileTypes.Num(); ++i)
-    {
-        const FTileType& Tile = TileTypes[i];
+void UWaveFunctionCollapseComponent::AddCellConstraints(const TArray<FWFCCellConstraint>& Constraints)
+{
+    CellConstraints.Append(Constraints);
+}
+
+void UWaveFunctionCollapseComponent::ClearConstraints()
+{
+    CellConstraints.Reset();
+    BoundaryEdges.Reset();
+}
+
+bool UWaveFunctionCollapseComponent::CompileConstraints()
+{
+    static_assert(static_cast<int32>(EWFCGridSide::Bottom) == static_cast<int32>(EWFCDirection::Down), "Grid sides follow the solver's directions");
+
+    InitialConstraints.Reset();
+
+    if (CellConstraints.Num() == 0 && BoundaryEdges.Num() == 0)
+        return true;
 
-        // Check North edge
-        if (!CompatibleEdges.Contains(Tile.NorthEdge))
+    const int32 NumTiles = CompiledRules->GetNumTiles();
+    const int32 NumWords = CompiledRules->GetNumWords();
+
+    TSharedRef<FWFCInitialConstraints, ESPMode::ThreadSafe> Constraints = MakeShared<FWFCInitialConstraints, ESPMode::ThreadSafe>();
+    Constraints->Init(NumWords);
+
+    TArray<uint64, TInlineAllocator<4>> Mask;
+    Mask.SetNumUninitialized(NumWords);
+
+    // Restrict every cell of a box, given with Max exclusive
+    auto ConstrainBox = [this, &Constraints, &Mask](const FIntVector& Min, const FIntVector& Max)
+    {
+        for (int32 Z = Min.Z; Z < Max.Z; ++Z)
         {
-            UE_LOG(LogTemp, Warning, TEXT("Tile %d has North edge type with no compatibility rule"), i);
-            bRulesAreValid = false;
+            for (int32 Y = Min.Y; Y < Max.Y; ++Y)
+            {
+                for (int32 X = Min.X; X < Max.X; ++X)
+                {
+                    Constraints->Constrain(XYZToIndex(X, Y, Z), Mask.GetData());
+                }
+            }
         }
+    };
 
-        // Check East edge
-        if (!CompatibleEdges.Contains(Tile.EastEdge))
+    for (const FWFCCellConstraint& Constraint : CellConstraints)
+    {
+        const FIntVector Min(FMath::Max(Constraint.Cell.X, 0), FMath::Max(Constraint.Cell.Y, 0), FMath::Max(Constraint.Cell.Z, 0));
+        const FIntVector Max(
+            FMath::Min(Constraint.Cell.X + Constraint.Size.X, GridWidth),
+            FMath::Min(Constraint.Cell.Y + Constraint.Size.Y, GridHeight),
+            FMath::Min(Constraint.Cell.Z + Constraint.Size.Z, GridDepth));
+
+        if (Min.X >= Max.X || Min.Y >= Max.Y || Min.Z >= Max.Z)
         {
-            UE_LOG(LogTemp, Warning, TEXT("Tile %d has East edge type with no compatibility rule"), i);
-            bRulesAreValid = false;
+            UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse constraint at cell (%d, %d, %d) is outside the grid"), Constraint.Cell.X, Constraint.Cell.Y, Constraint.Cell.Z);
+            continue;
         }
 
-        // Check South edge
-        if (!CompatibleEdges.Contains(Tile.SouthEdge))
+        // Every variant of a listed tile type is allowed or banned, unless an allowed tile must have a certain turn
+        FMemory::Memzero(Mask.GetData(), NumWords * sizeof(uint64));
+        for (int32 Tile = 0; Tile < NumTiles; ++Tile)
         {
-            UE_LOG(LogTemp, Warning, TEXT("Tile %d has South edge type with no compatibility rule"), i);
-            bRulesAreValid = false;
+            const FWFCTileVariant& Variant = CompiledRules->GetVariant(Tile);
+            const bool bListed = Constraint.Tiles.Contains(Variant.SourceTile);
+            const bool bAllowed = Constraint.Type == EWFCCellConstraintType::Ban
+                ? !bListed
+                : bListed && (Constraint.Rotation < 0 || Variant.Rotation == Constraint.Rotation);
+
+            if (bAllowed)
+            {
+                WFCBits::Set(Mask.GetData(), Tile);
+            }
         }
 
-        // Check West edge
-        if (!CompatibleEdges.Contains(Tile.WestEdge))
+        ConstrainBox(Min, Max);
+    }
+
+    if (BoundaryEdges.Num() > 0 && Model == EWFCModel::Overlapping)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse ignores BoundaryEdges with the overlapping model, which has no edges"));
+    }
+    else if (BoundaryEdges.Num() > 0)
+    {
+        const FWFCEdgeMatrix Edges = MakeEdgeMatrix();
+
+        for (int32 Dir = 0; Dir < FWFCCompiledRules::NumDirections; ++Dir)
         {
-            UE_LOG(LogTemp, Warning, TEXT("Tile %d has West edge type with no compatibility rule"), i);
-            bRulesAreValid = false;
+            uint64 OutsideEdges = 0;
+            for (const FWFCBoundaryEdge& Boundary : BoundaryEdges)
+            {
+                if (static_cast<int32>(Boundary.Side) == Dir)
+                {
+                    OutsideEdges |= 1ull << static_cast<int32>(Boundary.Edge);
+                }
+            }
+
+            if (OutsideEdges == 0)
+                continue;
+
+            // Tiles whose edge on this side connects to one of the edge types outside it
+            FMemory::Memzero(Mask.GetData(), NumWords * sizeof(uint64));
+            for (int32 Tile = 0; Tile < NumTiles; ++Tile)
+            {
+                if (Edges.GetRow(CompiledRules->GetVariant(Tile).Edges[Dir]) & OutsideEdges)
+                {
+                    WFCBits::Set(Mask.GetData(), Tile);
+                }
+            }
+
+            // The layer of cells along this side
+            const FIntVector Offset = FWFCCompiledRules::GetOffset(static_cast<EWFCDirection>(Dir));
+            const FIntVector Min(Offset.X > 0 ? GridWidth - 1 : 0, Offset.Y > 0 ? GridHeight - 1 : 0, Offset.Z > 0 ? GridDepth - 1 : 0);
+            const FIntVector Max(Offset.X < 0 ? 1 : GridWidth, Offset.Y < 0 ? 1 : GridHeight, Offset.Z < 0 ? 1 : GridDepth);
+            ConstrainBox(Min, Max);
         }
     }
 
-    // Check for symmetry in compatibility rules
-    for (const auto& Pair : CompatibleEdges)
+    // Catch constraints that rule each other out before they turn into a failed solve
+    bool bValid = true;
+    Constraints->ForEach([this, NumWords, &bValid](int32 Cell, const uint64* CellMask)
     {
-        ETileEdgeType Edge1 = Pair.Key;
-        ETileEdgeType Edge2 = Pair.Value;
-
-        // Check if Edge2 has Edge1 as its compatible edge
-        const ETileEdgeType* ReverseCompatible = CompatibleEdges.Find(Edge2);
-        if (!ReverseCompatible || *ReverseCompatible != Edge1)
+        if (bValid && WFCBits::Count(CellMask, NumWords) == 0)
         {
-            UE_LOG(LogTemp, Warning, TEXT("Edge compatibility is not symmetric: %d -> %d, but %d -> %d"),
-                static_cast<int32>(Edge1), static_cast<int32>(Edge2),
-                static_cast<int32>(Edge2), ReverseCompatible ? static_cast<int32>(*ReverseCompatible) : -1);
-            bRulesAreValid = false;
+            int32 X, Y, Z;
+            IndexToXYZ(Cell, X, Y, Z);
+            UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse constraints leave no tile for cell (%d, %d, %d)"), X, Y, Z);
+            bValid = false;
         }
+    });
+
+    if (!bValid)
+        return false;
+
+    if (!Constraints->IsEmpty())
+    {
+        InitialConstraints = Constraints;
     }
+    return true;
+}
 
-    return bRulesAreValid;
+void UWaveFunctionCollapseComponent::PickSeed()
+{
+    NumRegionResolves = 0;
+
+    if (bRandomizeSeed)
+    {
+        Seed = FMath::RandHelper(MAX_int32);
+    }
 }
 
-bool UWaveFunctionCollapseComponent::IsGridFullyCollapsed()
+uint64 UWaveFunctionCollapseComponent::GetCacheKey(int32 RegionSize) const
 {
-    for (const FCell& Cell : Grid)
+    const FWFCSolverSettings Settings = MakeSolverSettings();
+
+    // The rule hash covers the tiles' edges and weights and the edge compatibility
+    uint64 Key = CompiledRules->GetHash();
+
+    const int32 Parameters[] =
     {
-        if (!Cell.bIsCollapsed)
-            return false;
+        Settings.Width, Settings.Height, Settings.Depth, Settings.Seed, static_cast<int32>(Settings.Propagator),
+        Settings.BacktrackDepth, Settings.MaxBacktracks, Settings.LocalRestartRadius, Settings.MaxLocalRestarts,
+        RegionSize
+    };
+    Key = CityHash64WithSeed(reinterpret_cast<const char*>(Parameters), sizeof(Parameters), Key);
+
+    if (InitialConstraints)
+    {
+        const uint64 ConstraintHash = InitialConstraints->GetHash();
+        Key = CityHash64WithSeed(reinterpret_cast<const char*>(&ConstraintHash), sizeof(ConstraintHash), Key);
     }
 
-    return true;
+    // Meshes don't change the solve, but they identify the tile set the cached indices refer to
+    for (const FTileType& Tile : TileTypes)
+    {
+        const FString MeshPath = Tile.Mesh ? Tile.Mesh->GetPathName() : FString();
+        Key = CityHash64WithSeed(reinterpret_cast<const char*>(*MeshPath), MeshPath.Len() * sizeof(TCHAR), Key);
+    }
+
+    return Key;
 }
 
-void UWaveFunctionCollapseComponent::IndexToXY(int32 Index, int32& OutX, int32& OutY)
+bool UWaveFunctionCollapseComponent::SpawnCachedResult(int32 RegionSize)
 {
-    OutX = Index % GridWidth;
-    OutY = Index / GridWidth;
+    // Taken even without caching, so clients can look the grid up in their own cache
+    GenerationCacheKey = GetCacheKey(RegionSize);
+    GenerationRegionSize = RegionSize;
+
+    if (!bCacheResults)
+        return false;
+
+    FWFCGridData Cached;
+    if (!FWFCResultCache::Get().Find(GenerationCacheKey, Cached, bCacheOnDisk) || Cached.Width != GridWidth || Cached.Height != GridHeight || Cached.Depth != GridDepth)
+        return false;
+
+    FinalStates = MoveTemp(Cached.States);
+    FinalRules = CompiledRules;
+
+    // Nothing was solved, so GetCell reads the cached tiles instead of a stale wave
+    Solver.Clear();
+
+    SpawnTileMeshes();
+    SyncReplicatedGeneration();
+    OnGenerationComplete.Broadcast(true);
+    return true;
 }
 
-int32 UWaveFunctionCollapseComponent::XYToIndex(int32 X, int32 Y)
+void UWaveFunctionCollapseComponent::ClearResultCache()
 {
-    return Y * GridWidth + X;
+    FWFCResultCache::Get().Clear(true);
+    FWFCOverlappingModel::ClearPatternCache();
 }
 
-void UWaveFunctionCollapseComponent::SpawnTileMeshes()
+TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> UWaveFunctionCollapseComponent::BuildOverlappingRules()
 {
-    UWorld* World = GetWorld();
-    if (!World)
-        return;
+    // Patterns are taken from a flat sample and can't say anything about the layers above and below
+    if (GridDepth > 1)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse overlapping model only supports grids one layer deep"));
+        return nullptr;
+    }
 
-    // Get the component's owner location as origin
-    FVector Origin = GetOwner()->GetActorLocation();
+    FWFCSample Sample;
+    if (!ReadSample(Sample))
+        return nullptr;
 
-    // Spawn a static mesh for each cell
-    for (int32 i = 0; i < Grid.Num(); ++i)
+    if (!bPeriodicSample && (Sample.Width < PatternSize || Sample.Height < PatternSize))
     {
-        const FCell& Cell = Grid[i];
+        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse sample (%d x %d) is smaller than its patterns (%d)"), Sample.Width, Sample.Height, PatternSize);
+        return nullptr;
+    }
 
-        if (Cell.bIsCollapsed && Cell.FinalState >= 0 && Cell.FinalState < TileTypes.Num())
-        {
-            int32 X, Y;
-            IndexToXY(i, X, Y);
+    // Extraction is shared by every generation from the same sample
+    FWFCOverlappingModel::FPatternsRef Patterns = FWFCOverlappingModel::GetPatterns(Sample, PatternSize, bPeriodicSample);
 
-            // Calculate the position of this tile
-            FVector Position = Origin + FVector(X * TileSize, Y * TileSize, 0);
+    TSharedRef<FWFCCompiledRules, ESPMode::ThreadSafe> Rules = MakeShared<FWFCCompiledRules, ESPMode::ThreadSafe>();
+    Rules->CompilePatterns(*Patterns);
+    return Rules;
+}
+
+bool UWaveFunctionCollapseComponent::ReadSample(FWFCSample& OutSample) const
+{
+    if (TileTypes.Num() == 0)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("No tile types defined"));
+        return false;
+    }
+
+    if (!SampleTexture)
+    {
+        if (SampleGridWidth <= 0 || SampleGrid.Num() == 0 || SampleGrid.Num() % SampleGridWidth != 0)
+        {
+            UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse needs a SampleTexture, or a SampleGrid made of whole rows of SampleGridWidth cells"));
+            return false;
+        }
+
+        for (int32 Value : SampleGrid)
+        {
+            if (!TileTypes.IsValidIndex(Value))
+            {
+                UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse SampleGrid refers to tile %d, which doesn't exist"), Value);
+                return false;
+            }
+        }
+
+        OutSample.Width = SampleGridWidth;
+        OutSample.Height = SampleGrid.Num() / SampleGridWidth;
+        OutSample.Values = SampleGrid;
+        return true;
+    }
+
+    if (SamplePalette.Num() == 0 || SamplePalette.Num() > TileTypes.Num())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse SamplePalette needs one color per tile type"));
+        return false;
+    }
+
+    const FTexturePlatformData* PlatformData = SampleTexture->GetPlatformData();
+    if (!PlatformData || PlatformData->Mips.Num() == 0 || PlatformData->PixelFormat != PF_B8G8R8A8)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse can't read %s; use the UserInterface2D compression setting without mipmaps"), *SampleTexture->GetName());
+        return false;
+    }
+
+    const FTexture2DMipMap& Mip = PlatformData->Mips[0];
+    const FColor* Pixels = static_cast<const FColor*>(Mip.BulkData.LockReadOnly());
+    if (!Pixels)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse can't read the pixels of %s"), *SampleTexture->GetName());
+        return false;
+    }
+
+    OutSample.Width = Mip.SizeX;
+    OutSample.Height = Mip.SizeY;
+    OutSample.Values.SetNumUninitialized(Mip.SizeX * Mip.SizeY);
+
+    // Samples use few colors, so each distinct one is matched to the palette once
+    TMap<FColor, int32> PaletteIndices;
+    for (int32 i = 0; i < OutSample.Values.Num(); ++i)
+    {
+        const FColor Pixel = Pixels[i];
+        if (const int32* Found = PaletteIndices.Find(Pixel))
+        {
+            OutSample.Values[i] = *Found;
+            continue;
+        }
+
+        int32 Closest = 0;
+        int32 ClosestDistance = MAX_int32;
+        for (int32 Entry = 0; Entry < SamplePalette.Num(); ++Entry)
+        {
+            const FColor& Color = SamplePalette[Entry];
+            const int32 Distance = FMath::Square(Pixel.R - Color.R) + FMath::Square(Pixel.G - Color.G) + FMath::Square(Pixel.B - Color.B) + FMath::Square(Pixel.A - Color.A);
+            if (Distance < ClosestDistance)
+            {
+                Closest = Entry;
+                ClosestDistance = Distance;
+            }
+        }
+
+        PaletteIndices.Add(Pixel, Closest);
+        OutSample.Values[i] = Closest;
+    }
+
+    Mip.BulkData.Unlock();
+    return true;
+}
+
+bool UWaveFunctionCollapseComponent::ExportGrid(const FString& FilePath, bool bCompress)
+{
+    if (!CompiledRules || FinalStates.Num() != GetNumCells())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse has no generated grid of the current size to export"));
+        return false;
+    }
+
+    if (!FWFCGridFile::SaveToFile(FilePath, MakeGridData(), bCompress))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse could not write grid file %s"), *FilePath);
+        return false;
+    }
+
+    return true;
+}
+
+bool UWaveFunctionCollapseComponent::ImportGrid(const FString& FilePath)
+{
+    FWFCGridData Grid;
+    if (!FWFCGridFile::LoadFromFile(FilePath, Grid))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse could not read grid file %s"), *FilePath);
+        return false;
+    }
+
+    return ApplyGridData(MoveTemp(Grid));
+}
+
+void UWaveFunctionCollapseComponent::ImportGridAsync(const FString& FilePath)
+{
+    CancelGeneration();
+
+    // Tracked like an asynchronous solve, so a newer generation discards the loaded grid
+    TSharedPtr<FAsyncGeneration, ESPMode::ThreadSafe> Generation = MakeShared<FAsyncGeneration, ESPMode::ThreadSafe>();
+    PendingGeneration = Generation;
+    TWeakObjectPtr<UWaveFunctionCollapseComponent> WeakThis(this);
+
+    FWFCGridFile::LoadFromFileAsync(FilePath, [WeakThis, Generation, FilePath](bool bSuccess, FWFCGridData&& Grid)
+    {
+        UWaveFunctionCollapseComponent* This = WeakThis.Get();
+        if (!This || This->PendingGeneration != Generation || Generation->bCancelled)
+            return;
+
+        This->PendingGeneration.Reset();
+
+        if (!bSuccess)
+        {
+            UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse could not read grid file %s"), *FilePath);
+            This->OnGenerationComplete.Broadcast(false);
+            return;
+        }
+
+        if (!This->ApplyGridData(MoveTemp(Grid)))
+        {
+            This->OnGenerationComplete.Broadcast(false);
+        }
+    });
+}
+
+FWFCGridData UWaveFunctionCollapseComponent::MakeGridData() const
+{
+    FWFCGridData Grid;
+    Grid.Width = GridWidth;
+    Grid.Height = GridHeight;
+    Grid.Depth = GridDepth;
+    Grid.NumTiles = CompiledRules ? CompiledRules->GetNumTiles() : TileTypes.Num();
+    Grid.Seed = Seed;
+    Grid.RuleHash = CompiledRules ? CompiledRules->GetHash() : 0;
+    Grid.States = FinalStates;
+    return Grid;
+}
+
+bool UWaveFunctionCollapseComponent::ApplyGridData(FWFCGridData&& Grid)
+{
+    CancelGeneration();
+
+    if (!CompileRules())
+        return false;
+
+    // Tile indices only mean something with the rules they were solved with
+    if (Grid.NumTiles != CompiledRules->GetNumTiles() || Grid.RuleHash != CompiledRules->GetHash())
+    {
+        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse grid was saved with different tile rules"));
+        return false;
+    }
+
+    GridWidth = Grid.Width;
+    GridHeight = Grid.Height;
+    GridDepth = Grid.Depth;
+    Seed = Grid.Seed;
+    FinalStates = MoveTemp(Grid.States);
+    FinalRules = CompiledRules;
+
+    // The loaded grid isn't under any cache key
+    GenerationCacheKey = 0;
+    GenerationRegionSize = GetParallelRegionSize();
+
+    // Nothing was solved, so GetCell reads the loaded tiles
+    Solver.Clear();
+
+    SpawnTileMeshes();
+    SyncReplicatedGeneration();
+    OnGenerationComplete.Broadcast(true);
+    return true;
+}
+
+FWFCSolverSettings UWaveFunctionCollapseComponent::MakeSolverSettings() const
+{
+    FWFCSolverSettings Settings;
+    Settings.Width = GridWidth;
+    Settings.Height = GridHeight;
+    Settings.Depth = GridDepth;
+    Settings.Propagator = Propagator;
+    Settings.Seed = Seed;
+    Settings.BacktrackDepth = BacktrackDepth;
+    Settings.MaxBacktracks = MaxBacktracks;
+    Settings.LocalRestartRadius = LocalRestartRadius;
+    Settings.MaxLocalRestarts = MaxLocalRestarts;
+    Settings.Constraints = InitialConstraints;
+    return Settings;
+}
+
+int32 UWaveFunctionCollapseComponent::GetParallelRegionSize() const
+{
+    return bSolveRegionsInParallel ? ParallelRegionSize : 0;
+}
+
+EWFCSolveStatus UWaveFunctionCollapseComponent::RunSolve(FWFCSolver& TargetSolver, FWFCSolver::FRulesRef Rules, const FWFCSolverSettings& Settings, int32 RegionSize, const std::atomic<bool>* bCancelled)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(WFC_Solve);
+    SCOPE_CYCLE_COUNTER(STAT_WFC_Solve);
+
+    if (RegionSize > 0)
+    {
+        FWFCParallelSolver ParallelSolver;
+        ParallelSolver.RegionSize = RegionSize;
+        return ParallelSolver.Solve(TargetSolver, Rules, Settings, bCancelled);
+    }
+
+    TargetSolver.Init(Rules, Settings);
+    return TargetSolver.Run(bCancelled);
+}
+
+void UWaveFunctionCollapseComponent::FinishGeneration(EWFCSolveStatus Status, int32 MaxIterations, bool bReproducible)
+{
+    if (Status == EWFCSolveStatus::Incomplete)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse reached max iterations (%d). Grid may be incomplete."), MaxIterations);
+    }
+    else if (Status == EWFCSolveStatus::Failed)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse hit a contradiction it could not resolve. Increase MaxBacktracks or MaxLocalRestarts, or check the edge rules."));
+    }
+
+    // The cache key describes a CPU solve, so other grids under it would be returned for that solve.
+    // A randomized seed is never asked for again, so its grid would only take up room.
+    if (Status == EWFCSolveStatus::Completed && bCacheResults && bReproducible && !bRandomizeSeed)
+    {
+        FWFCResultCache::Get().Store(GenerationCacheKey, MakeGridData(), bCacheOnDisk);
+    }
+
+    // Spawn the meshes
+    SpawnTileMeshes();
+
+    SyncReplicatedGeneration(bReproducible);
+    OnGenerationComplete.Broadcast(Status == EWFCSolveStatus::Completed);
+}
+
+int32 UWaveFunctionCollapseComponent::GetGridChecksum() const
+{
+    return static_cast<int32>(FCrc::MemCrc32(FinalStates.GetData(), FinalStates.Num() * sizeof(int32)));
+}
+
+bool UWaveFunctionCollapseComponent::IsReplicatedClient() const
+{
+    const AActor* Owner = GetOwner();
+    return bReplicateGeneration && Owner && !Owner->HasAuthority();
+}
+
+void UWaveFunctionCollapseComponent::OnRep_ReplicatedGeneration()
+{
+    // BeginPlay picks up a description that arrives with the initial replication
+    if (HasBegunPlay())
+    {
+        ApplyReplicatedGeneration();
+    }
+}
+
+void UWaveFunctionCollapseComponent::SyncReplicatedGeneration(bool bReproducible)
+{
+    if (!bReplicateGeneration)
+        return;
+
+    if (IsReplicatedClient())
+    {
+        // The rebuilt grid is in place; replay the resolves and verify it
+        ApplyReplicatedGeneration();
+        return;
+    }
+
+    // Ids keep counting across grids that aren't replicated, so clients never mistake a later generation for one they have
+    NumReplicatedGenerations = NumReplicatedGenerations % MAX_int32 + 1;
+
+    if (!bReproducible)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse can't replicate a grid clients can't solve again, like a GPU bake; clients keep their last grid"));
+        ReplicatedGeneration = FWFCReplicatedGeneration();
+        return;
+    }
+
+    ReplicatedGeneration.GenerationId = NumReplicatedGenerations;
+    ReplicatedGeneration.Seed = Seed;
+    ReplicatedGeneration.Width = GridWidth;
+    ReplicatedGeneration.Height = GridHeight;
+    ReplicatedGeneration.Depth = GridDepth;
+    ReplicatedGeneration.RuleHash = CompiledRules ? CompiledRules->GetHash() : 0;
+    ReplicatedGeneration.ConstraintHash = InitialConstraints ? InitialConstraints->GetHash() : 0;
+    ReplicatedGeneration.Propagator = Propagator;
+    ReplicatedGeneration.BacktrackDepth = BacktrackDepth;
+    ReplicatedGeneration.MaxBacktracks = MaxBacktracks;
+    ReplicatedGeneration.LocalRestartRadius = LocalRestartRadius;
+    ReplicatedGeneration.MaxLocalRestarts = MaxLocalRestarts;
+    ReplicatedGeneration.RegionSize = GenerationRegionSize;
+    ReplicatedGeneration.CacheKey = GenerationCacheKey;
+    ReplicatedGeneration.Checksum = static_cast<uint32>(GetGridChecksum());
+    ReplicatedGeneration.Resolves.Reset();
+}
+
+void UWaveFunctionCollapseComponent::RecordReplicatedResolve(const FIntRect& Region, int32 ResolveIndex)
+{
+    if (!bReplicateGeneration || IsReplicatedClient() || ReplicatedGeneration.GenerationId == 0)
+        return;
+
+    FWFCReplicatedResolve Resolve;
+    Resolve.Min = Region.Min;
+    Resolve.Max = Region.Max;
+    Resolve.ResolveIndex = ResolveIndex;
+    ReplicatedGeneration.Resolves.Add(Resolve);
+    ReplicatedGeneration.Checksum = static_cast<uint32>(GetGridChecksum());
+}
+
+void UWaveFunctionCollapseComponent::ApplyReplicatedGeneration()
+{
+    const FWFCReplicatedGeneration& Generation = ReplicatedGeneration;
+    if (Generation.GenerationId == 0)
+        return;
+
+    if (Generation.GenerationId != AppliedGenerationId)
+    {
+        AppliedGenerationId = Generation.GenerationId;
+        NumAppliedResolves = 0;
+
+        // Solve exactly what the server solved, with its solver settings
+        GridWidth = Generation.Width;
+        GridHeight = Generation.Height;
+        GridDepth = Generation.Depth;
+        Seed = Generation.Seed;
+        Propagator = Generation.Propagator;
+        BacktrackDepth = Generation.BacktrackDepth;
+        MaxBacktracks = Generation.MaxBacktracks;
+        LocalRestartRadius = Generation.LocalRestartRadius;
+        MaxLocalRestarts = Generation.MaxLocalRestarts;
+        bSolveRegionsInParallel = Generation.RegionSize > 0;
+        if (bSolveRegionsInParallel)
+        {
+            ParallelRegionSize = Generation.RegionSize;
+        }
+
+        if (!CompileRules())
+        {
+            bGridInSync = false;
+            return;
+        }
+
+        const uint64 ConstraintHash = InitialConstraints ? InitialConstraints->GetHash() : 0;
+        if (CompiledRules->GetHash() == Generation.RuleHash && ConstraintHash == Generation.ConstraintHash)
+        {
+            // Done when the grid is in place, which on a cache hit is before this returns
+            TGuardValue<bool> KeepSeed(bRandomizeSeed, false);
+            GenerateGridAsync();
+            return;
+        }
+
+        // Solving here can't give the server's grid, but it may be in the result cache, e.g. shipped in Saved/WFCCache
+        if (!SpawnReplicatedCachedResult())
+        {
+            bGridInSync = false;
+            UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse rules or constraints on this client don't match the server's, and its grid isn't in the result cache; the grid was not generated"));
+            return;
+        }
+
+        UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse rules or constraints on this client don't match the server's; its grid was loaded from the result cache"));
+    }
+
+    if (IsGenerating())
+        return;
+
+    // Regions only match if they are re-solved in the server's order with the server's seeds
+    while (NumAppliedResolves < Generation.Resolves.Num())
+    {
+        const FWFCReplicatedResolve& Resolve = Generation.Resolves[NumAppliedResolves++];
+        NumRegionResolves = Resolve.ResolveIndex;
+        ResolveRegion(FIntRect(Resolve.Min, Resolve.Max));
+    }
+
+    const uint32 Checksum = static_cast<uint32>(GetGridChecksum());
+    bGridInSync = Checksum == Generation.Checksum;
+    if (!bGridInSync)
+    {
+        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse grid checksum %08x doesn't match the server's %08x; check that client and server share rules and settings"), Checksum, Generation.Checksum);
+    }
+}
+
+bool UWaveFunctionCollapseComponent::SpawnReplicatedCachedResult()
+{
+    const FWFCReplicatedGeneration& Generation = ReplicatedGeneration;
+
+    FWFCGridData Cached;
+    if (Generation.CacheKey == 0 || !FWFCResultCache::Get().Find(Generation.CacheKey, Cached, true))
+        return false;
+
+    // Tile indices only mean something with the rules they were solved with
+    if (Cached.NumTiles != CompiledRules->GetNumTiles() || Cached.RuleHash != CompiledRules->GetHash()
+        || Cached.Width != GridWidth || Cached.Height != GridHeight || Cached.Depth != GridDepth)
+        return false;
+
+    CancelGeneration();
+    FinalStates = MoveTemp(Cached.States);
+    FinalRules = CompiledRules;
+
+    // Nothing was solved, so GetCell reads the cached tiles
+    Solver.Clear();
+
+    SpawnTileMeshes();
+    OnGenerationComplete.Broadcast(true);
+    return true;
+}
+
+FWFCEdgeMatrix UWaveFunctionCollapseComponent::MakeEdgeMatrix() const
+{
+    FWFCEdgeMatrix Edges;
+
+    for (const TPair<ETileEdgeType, ETileEdgeType>& Pair : CompatibleEdges)
+    {
+        Edges.Allow(Pair.Key, Pair.Value);
+    }
+
+    for (const FEdgeCompatibility& Rule : EdgeCompatibility)
+    {
+        for (ETileEdgeType Other : Rule.CompatibleWith)
+        {
+            Edges.Allow(Rule.Edge, Other);
+        }
+    }
+
+    return Edges;
+}
+
+TArray<int32> UWaveFunctionCollapseComponent::GetTilesWithEdgeType(ETileEdgeType EdgeType, const FString& Direction)
+{
+    TArray<int32> MatchingTiles;
+
+    for (int32 i = 0; i < TileTypes.Num(); ++i)
+    {
+        const FTileType& Tile = TileTypes[i];
+
+        if (Direction == "North" && Tile.NorthEdge == EdgeType)
+            MatchingTiles.Add(i);
+        else if (Direction == "East" && Tile.EastEdge == EdgeType)
+            MatchingTiles.Add(i);
+        else if (Direction == "South" && Tile.SouthEdge == EdgeType)
+            MatchingTiles.Add(i);
+        else if (Direction == "West" && Tile.WestEdge == EdgeType)
+            MatchingTiles.Add(i);
+        else if (Direction == "Up" && Tile.UpEdge == EdgeType)
+            MatchingTiles.Add(i);
+        else if (Direction == "Down" && Tile.DownEdge == EdgeType)
+            MatchingTiles.Add(i);
+    }
+
+    return MatchingTiles;
+}
+
+bool UWaveFunctionCollapseComponent::VerifyGrid()
+{
+    if (FinalStates.Num() != GetNumCells())
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse has no generated grid of the current size to verify"));
+        return false;
+    }
+
+    // Overlapping rules only exist as the compiled table
+    if (Model == EWFCModel::Overlapping)
+    {
+        const int32 InvalidCell = CompiledRules ? FWFCSolver::FindInvalidCell(*CompiledRules, GridWidth, GridHeight, FinalStates, GridDepth) : 0;
+        if (InvalidCell >= 0)
+        {
+            int32 X, Y, Z;
+            IndexToXYZ(InvalidCell, X, Y, Z);
+            UE_LOG(LogTemp, Warning, TEXT("Cell (%d, %d, %d) has no pattern or doesn't overlap its neighbors"), X, Y, Z);
+            return false;
+        }
+        return true;
+    }
+
+    // Compare edges directly instead of going through the compiled adjacency table, so a bug in either shows up
+    const FWFCEdgeMatrix Edges = MakeEdgeMatrix();
+    TArray<FWFCTileVariant> Variants;
+    FWFCCompiledRules::MakeVariants(TileTypes, Variants);
+
+    // Each pair is checked once, from its west, north or lower cell
+    static const EWFCDirection Forward[] = { EWFCDirection::East, EWFCDirection::South, EWFCDirection::Up };
+    static const TCHAR* ForwardNames[] = { TEXT("east"), TEXT("south"), TEXT("upper") };
+
+    for (int32 Index = 0; Index < FinalStates.Num(); ++Index)
+    {
+        int32 X, Y, Z;
+        IndexToXYZ(Index, X, Y, Z);
+
+        const int32 Tile = FinalStates[Index];
+        if (!Variants.IsValidIndex(Tile))
+        {
+            UE_LOG(LogTemp, Warning, TEXT("Cell (%d, %d, %d) has no tile"), X, Y, Z);
+            return false;
+        }
+
+        const FWFCTileVariant& Variant = Variants[Tile];
+
+        for (int32 i = 0; i < static_cast<int32>(UE_ARRAY_COUNT(Forward)); ++i)
+        {
+            const FIntVector Neighbor = FIntVector(X, Y, Z) + FWFCCompiledRules::GetOffset(Forward[i]);
+            if (Neighbor.X >= GridWidth || Neighbor.Y >= GridHeight || Neighbor.Z >= GridDepth)
+                continue;
 
-            // Get the mesh for this tile type
-            UStaticMesh* TileMesh = TileTypes[Cell.FinalState].Mesh;
+            const int32 NeighborTile = FinalStates[XYZToIndex(Neighbor.X, Neighbor.Y, Neighbor.Z)];
+            if (!Variants.IsValidIndex(NeighborTile))
+                continue;
 
-            if (TileMesh)
+            const ETileEdgeType Edge = Variant.Edges[static_cast<int32>(Forward[i])];
+            const ETileEdgeType NeighborEdge = Variants[NeighborTile].Edges[static_cast<int32>(FWFCCompiledRules::GetOppositeDirection(Forward[i]))];
+            if (!Edges.IsCompatible(Edge, NeighborEdge) || !Edges.IsCompatible(NeighborEdge, Edge))
             {
-                // Spawn the static mesh component
-                UStaticMeshComponent* MeshComponent = NewObject<UStaticMeshComponent>(GetOwner());
-                MeshComponent->SetStaticMesh(TileMesh);
-                MeshComponent->SetRelativeLocation(Position);
-                MeshComponent->RegisterComponent();
+                UE_LOG(LogTemp, Warning, TEXT("Cell (%d, %d, %d) doesn't match its %s neighbor"), X, Y, Z, ForwardNames[i]);
+                return false;
             }
         }
     }
-}
\ No newline at end of file
+
+    return true;
+}
+
+bool UWaveFunctionCollapseComponent::VerifyDeterminism()
+{
+    if (!CompileRules())
+        return false;
+
+    FWFCSolver::FRulesRef Rules = CompiledRules.ToSharedRef();
+    const FWFCSolverSettings Settings = MakeSolverSettings();
+
+    TArray<int32> States[2];
+    for (TArray<int32>& Result : States)
+    {
+        FWFCSolverPool::FScopedSolver VerifySolver;
+        RunSolve(*VerifySolver, Rules, Settings, GetParallelRegionSize());
+        VerifySolver->GetFinalStates(Result);
+    }
+
+    if (States[0] != States[1])
+    {
+        UE_LOG(LogTemp, Warning, TEXT("Wave Function Collapse gave different grids for seed %d"), Seed);
+        return false;
+    }
+
+    return true;
+}
+
+bool UWaveFunctionCollapseComponent::AreEdgesCompatible(ETileEdgeType Edge, ETileEdgeType Other) const
+{
+    return MakeEdgeMatrix().IsCompatible(Edge, Other);
+}
+
+bool UWaveFunctionCollapseComponent::ValidateEdgeRules()
+{
+    // The overlapping model doesn't use edges; its sample is checked when the rules are compiled
+    if (Model == EWFCModel::Overlapping)
+        return true;
+
+    if (TileTypes.Num() == 0)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("No tile types defined"));
+        return false;
+    }
+
+    bool bRulesAreValid = true;
+
+    const FWFCEdgeMatrix Edges = MakeEdgeMatrix();
+    static const TCHAR* DirectionNames[FWFCCompiledRules::NumDirections] = { TEXT("North"), TEXT("East"), TEXT("South"), TEXT("West"), TEXT("Up"), TEXT("Down") };
+
+    // A single layer never shows its up and down edges, so they don't need rules
+    const int32 NumDirections = GridDepth > 1 ? FWFCCompiledRules::NumDirections : FWFCCompiledRules::NumHorizontalDirections;
+
+    // Rotated and reflected variants show their edges on other sides, so check those too
+    TArray<FWFCTileVariant> Variants;
+    FWFCCompiledRules::MakeVariants(TileTypes, Variants);
+
+    // Edge types shown on each side by some tile
+    uint64 UsedEdges[FWFCCompiledRules::NumDirections] = {};
+    for (const FWFCTileVariant& Variant : Variants)
+    {
+        for (int32 Dir = 0; Dir < NumDirections; ++Dir)
+        {
+            UsedEdges[Dir] |= 1ull << static_cast<int32>(Variant.Edges[Dir]);
+        }
+    }
+
+    // Check that all edge types have compatibility rules
+    for (const FWFCTileVariant& Variant : Variants)
+    {
+        // Every variant has the edge types of its tile, so missing rules are reported on the authored orientation only
+        const bool bAuthored = Variant.Rotation == 0 && !Variant.bReflected;
+
+        for (int32 Dir = 0; Dir < NumDirections; ++Dir)
+        {
+            const EWFCDirection Direction = static_cast<EWFCDirection>(Dir);
+            const uint64 Compatible = Edges.GetRow(Variant.Edges[Dir]);
+
+            if (Compatible == 0)
+            {
+                if (bAuthored)
+                {
+                    UE_LOG(LogTemp, Warning, TEXT("Tile %d has %s edge type with no compatibility rule"), Variant.SourceTile, DirectionNames[Dir]);
+                }
+                bRulesAreValid = false;
+            }
+            else if ((Compatible & UsedEdges[static_cast<int32>(FWFCCompiledRules::GetOppositeDirection(Direction))]) == 0)
+            {
+                // Not an error, border tiles are built like this, but often a typo in the rules
+                UE_LOG(LogTemp, Log, TEXT("Tile %d (turned %d degrees%s) has %s edge type that no tile can be placed against; it can only border the grid edge"),
+                    Variant.SourceTile, Variant.Rotation * 90, Variant.bReflected ? TEXT(", mirrored") : TEXT(""), DirectionNames[Dir]);
+            }
+        }
+    }
+
+    // Check for symmetry in compatibility rules
+    for (int32 Edge1 = 0; Edge1 < FWFCEdgeMatrix::NumEdgeTypes; ++Edge1)
+    {
+        for (int32 Edge2 = 0; Edge2 < FWFCEdgeMatrix::NumEdgeTypes; ++Edge2)
+        {
+            // Check if Edge2 has Edge1 as a compatible edge
+            if (Edges.IsCompatible(static_cast<ETileEdgeType>(Edge1), static_cast<ETileEdgeType>(Edge2)) && !Edges.IsCompatible(static_cast<ETileEdgeType>(Edge2), static_cast<ETileEdgeType>(Edge1)))
+            {
+                UE_LOG(LogTemp, Warning, TEXT("Edge compatibility is not symmetric: %d -> %d, but not %d -> %d"), Edge1, Edge2, Edge2, Edge1);
+                bRulesAreValid = false;
+            }
+        }
+    }
+
+    return bRulesAreValid;
+}
+
+FCell UWaveFunctionCollapseComponent::GetCell(int32 X, int32 Y, int32 Z) const
+{
+    FCell Cell;
+
+    if (X < 0 || X >= GridWidth || Y < 0 || Y >= GridHeight || Z < 0 || Z >= GridDepth)
+        return Cell;
+
+    int32 Index = XYZToIndex(X, Y, Z);
+
+    // CompileRules may have replaced the table since the last synchronous solve, e.g. for VerifyDeterminism,
+    // so its wave is read with the rules it was solved with
+    const FWFCCompiledRules* WaveRules = Solver.GetRules();
+    const bool bHasWave = WaveRules && Solver.GetWidth() == GridWidth && Solver.GetHeight() == GridHeight && Solver.GetDepth() == GridDepth;
+    const FWFCCompiledRules* Rules = bHasWave ? WaveRules : CompiledRules.Get();
+    if (!Rules)
+        return Cell;
+
+    int32 FinalState = -1;
+    if (bHasWave)
+    {
+        // The last synchronous solve still has the full wave
+        TArray<int32> States;
+        Solver.GetCellStates(Index, States);
+        for (int32 State : States)
+        {
+            // Report tile types; the variants of one type only differ in orientation
+            if (State < Rules->GetNumTiles())
+            {
+                Cell.PossibleStates.AddUnique(Rules->GetVariant(State).SourceTile);
+            }
+        }
+        FinalState = Solver.IsCellCollapsed(Index) && States.Num() > 0 && States[0] < Rules->GetNumTiles() ? States[0] : -1;
+    }
+    else if (FinalStates.IsValidIndex(Index) && FinalStates[Index] >= 0 && FinalStates[Index] < Rules->GetNumTiles())
+    {
+        // Asynchronous solves only hand back the final tile of each cell
+        FinalState = FinalStates[Index];
+        Cell.PossibleStates.Add(Rules->GetVariant(FinalState).SourceTile);
+    }
+
+    if (FinalState >= 0)
+    {
+        const FWFCTileVariant& Variant = Rules->GetVariant(FinalState);
+        Cell.bIsCollapsed = true;
+        Cell.FinalState = Variant.SourceTile;
+        Cell.Rotation = Variant.Rotation;
+        Cell.bReflected = Variant.bReflected;
+    }
+
+    return Cell;
+}
+
+void UWaveFunctionCollapseComponent::IndexToXYZ(int32 Index, int32& OutX, int32& OutY, int32& OutZ) const
+{
+    OutX = Index % GridWidth;
+    OutY = (Index / GridWidth) % GridHeight;
+    OutZ = Index / (GridWidth * GridHeight);
+}
+
+int32 UWaveFunctionCollapseComponent::XYZToIndex(int32 X, int32 Y, int32 Z) const
+{
+    return (Z * GridHeight + Y) * GridWidth + X;
+}
+
+void UWaveFunctionCollapseComponent::SpawnTileMeshes()
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(WFC_SpawnTileMeshes);
+    SCOPE_CYCLE_COUNTER(STAT_WFC_SpawnTileMeshes);
+
+    UWorld* World = GetWorld();
+    if (!World)
+        return;
+
+    // Get the component's owner location as origin
+    FVector Origin = GetOwner()->GetActorLocation();
+    PrepareSpawnedTiles(Origin);
+
+    const bool bInstanced = OutputMode != EWFCOutputMode::StaticMeshComponents;
+    if (bInstanced)
+    {
+        // Tile meshes may have been edited even where no cell changed
+        for (int32 TileIndex = 0; TileIndex < TileTypes.Num() && TileIndex < TileInstances.Num(); ++TileIndex)
+        {
+            if (TileInstances[TileIndex])
+            {
+                GetTileInstances(TileIndex);
+            }
+        }
+    }
+
+    // Release every changed cell first so the new tiles can reuse what they leave behind
+    TArray<int32> ChangedCells;
+    for (int32 i = 0; i < FinalStates.Num(); ++i)
+    {
+        const int32 ShownState = GetShownState(i);
+        const bool bMeshChanged = !bInstanced && ShownState >= 0 && CellComponents[i] && CellComponents[i]->GetStaticMesh() != TileTypes[GetSourceTile(ShownState)].Mesh;
+
+        if (ShownState != SpawnedStates[i] || bMeshChanged)
+        {
+            ReleaseTile(i, false);
+            ChangedCells.Add(i);
+        }
+    }
+
+    TArray<TArray<int32>> DeferredCells;
+    DeferredCells.SetNum(TileTypes.Num());
+
+    for (int32 CellIndex : ChangedCells)
+    {
+        AcquireTile(CellIndex, Origin, &DeferredCells);
+    }
+
+    if (!bInstanced)
+        return;
+
+    // Cells that found no parked instance get all their new instances in one call per tile type
+    TArray<FTransform> Transforms;
+    for (int32 TileIndex = 0; TileIndex < DeferredCells.Num(); ++TileIndex)
+    {
+        const TArray<int32>& Cells = DeferredCells[TileIndex];
+        if (Cells.Num() == 0)
+            continue;
+
+        Transforms.Reset(Cells.Num());
+        for (int32 CellIndex : Cells)
+        {
+            Transforms.Add(GetTileTransform(CellIndex, Origin, SpawnedStates[CellIndex]));
+        }
+
+        const TArray<int32> Indices = GetTileInstances(TileIndex)->AddInstances(Transforms, true);
+        for (int32 i = 0; i < Cells.Num(); ++i)
+        {
+            SpawnedInstances[Cells[i]] = Indices[i];
+        }
+    }
+
+    CompactTileInstances();
+
+    for (UInstancedStaticMeshComponent* Instances : TileInstances)
+    {
+        if (Instances)
+        {
+            Instances->MarkRenderStateDirty();
+        }
+    }
+}
+
+void UWaveFunctionCollapseComponent::SpawnTile(int32 CellIndex, const FVector& Origin)
+{
+    if (!SpawnedStates.IsValidIndex(CellIndex) || GetShownState(CellIndex) == SpawnedStates[CellIndex])
+        return;
+
+    ReleaseTile(CellIndex, true);
+    AcquireTile(CellIndex, Origin, nullptr);
+}
+
+int32 UWaveFunctionCollapseComponent::GetShownState(int32 CellIndex) const
+{
+    const int32 FinalState = FinalStates[CellIndex];
+
+    if (!CompiledRules || FinalState < 0 || FinalState >= CompiledRules->GetNumTiles())
+        return -1;
+
+    const int32 SourceTile = GetSourceTile(FinalState);
+    if (!TileTypes.IsValidIndex(SourceTile) || !TileTypes[SourceTile].Mesh)
+        return -1;
+
+    return FinalState;
+}
+
+int32 UWaveFunctionCollapseComponent::GetSourceTile(int32 State) const
+{
+    return CompiledRules->GetVariant(State).SourceTile;
+}
+
+FVector UWaveFunctionCollapseComponent::GetTileLocation(int32 CellIndex, const FVector& Origin) const
+{
+    int32 X, Y, Z;
+    IndexToXYZ(CellIndex, X, Y, Z);
+
+    // Calculate the position of this tile
+    return Origin + FVector(X * TileSize, Y * TileSize, Z * LayerHeight);
+}
+
+FTransform UWaveFunctionCollapseComponent::GetTileTransform(int32 CellIndex, const FVector& Origin, int32 State) const
+{
+    return CompiledRules->GetVariant(State).MakeTransform(GetTileLocation(CellIndex, Origin));
+}
+
+bool UWaveFunctionCollapseComponent::PrepareSpawnedTiles(const FVector& Origin)
+{
+    const int32 NumCells = FinalStates.Num();
+
+    const bool bSameLayout = SpawnedStates.Num() == NumCells
+        && FreeInstances.Num() == TileTypes.Num()
+        && SpawnedOrigin.Equals(Origin)
+        && SpawnedTileSize == TileSize
+        && SpawnedLayerHeight == LayerHeight
+        && SpawnedWidth == GridWidth
+        && SpawnedHeight == GridHeight
+        && SpawnedOutputMode == OutputMode
+        && SpawnedRuleHash == (CompiledRules ? CompiledRules->GetHash() : 0);
+
+    if (bSameLayout)
+        return true;
+
+    // Every tile would move, or tile indices mean other variants now, so start over
+    ReleaseAllTiles();
+
+    SpawnedStates.Init(-1, NumCells);
+    SpawnedInstances.Init(INDEX_NONE, NumCells);
+    CellComponents.Init(nullptr, NumCells);
+    FreeInstances.Reset();
+    FreeInstances.SetNum(TileTypes.Num());
+
+    SpawnedOrigin = Origin;
+    SpawnedTileSize = TileSize;
+    SpawnedLayerHeight = LayerHeight;
+    SpawnedWidth = GridWidth;
+    SpawnedHeight = GridHeight;
+    SpawnedOutputMode = OutputMode;
+    SpawnedRuleHash = CompiledRules ? CompiledRules->GetHash() : 0;
+    return false;
+}
+
+void UWaveFunctionCollapseComponent::ReleaseAllTiles()
+{
+    for (TObjectPtr<UStaticMeshComponent>& MeshComponent : CellComponents)
+    {
+        if (MeshComponent)
+        {
+            MeshComponent->SetVisibility(false);
+            MeshComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+            ComponentPool.Add(MeshComponent);
+            MeshComponent = nullptr;
+        }
+    }
+
+    ClearTileInstances();
+
+    for (TArray<int32>& Free : FreeInstances)
+    {
+        Free.Reset();
+    }
+
+    SpawnedStates.Init(-1, SpawnedStates.Num());
+    SpawnedInstances.Init(INDEX_NONE, SpawnedInstances.Num());
+}
+
+void UWaveFunctionCollapseComponent::ReleaseTile(int32 CellIndex, bool bMarkDirty)
+{
+    const int32 SpawnedState = SpawnedStates[CellIndex];
+    if (SpawnedState < 0)
+        return;
+
+    if (SpawnedOutputMode == EWFCOutputMode::StaticMeshComponents)
+    {
+        if (UStaticMeshComponent* MeshComponent = CellComponents[CellIndex])
+        {
+            MeshComponent->SetVisibility(false);
+            MeshComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+            ComponentPool.Add(MeshComponent);
+            CellComponents[CellIndex] = nullptr;
+        }
+    }
+    else if (const int32 SourceTile = GetSourceTile(SpawnedState); TileInstances.IsValidIndex(SourceTile) && TileInstances[SourceTile])
+    {
+        // Removing an instance renumbers others, so park it at zero scale instead
+        const int32 InstanceIndex = SpawnedInstances[CellIndex];
+        const FTransform Parked(FQuat::Identity, GetTileLocation(CellIndex, SpawnedOrigin), FVector::ZeroVector);
+
+        if (TileInstances[SourceTile]->UpdateInstanceTransform(InstanceIndex, Parked, false, bMarkDirty, true))
+        {
+            FreeInstances[SourceTile].Add(InstanceIndex);
+        }
+    }
+
+    SpawnedStates[CellIndex] = -1;
+    SpawnedInstances[CellIndex] = INDEX_NONE;
+}
+
+void UWaveFunctionCollapseComponent::AcquireTile(int32 CellIndex, const FVector& Origin, TArray<TArray<int32>>* DeferredCells)
+{
+    const int32 ShownState = GetShownState(CellIndex);
+    if (ShownState < 0)
+        return;
+
+    // Every variant of a tile type shares its mesh, and in the instanced modes its component
+    const FTransform Transform = GetTileTransform(CellIndex, Origin, ShownState);
+    const int32 SourceTile = GetSourceTile(ShownState);
+    UStaticMesh* TileMesh = TileTypes[SourceTile].Mesh;
+    SpawnedStates[CellIndex] = ShownState;
+
+    if (OutputMode != EWFCOutputMode::StaticMeshComponents)
+    {
+        TArray<int32>& Free = FreeInstances[SourceTile];
+        if (Free.Num() > 0)
+        {
+            const int32 InstanceIndex = Free.Pop(EAllowShrinking::No);
+            GetTileInstances(SourceTile)->UpdateInstanceTransform(InstanceIndex, Transform, false, DeferredCells == nullptr, true);
+            SpawnedInstances[CellIndex] = InstanceIndex;
+        }
+        else if (DeferredCells)
+        {
+            (*DeferredCells)[SourceTile].Add(CellIndex);
+        }
+        else if (UInstancedStaticMeshComponent* Instances = GetTileInstances(SourceTile))
+        {
+            SpawnedInstances[CellIndex] = Instances->AddInstance(Transform);
+        }
+        return;
+    }
+
+    // Reuse a pooled component, skipping any destroyed since they were released
+    UStaticMeshComponent* MeshComponent = nullptr;
+    while (!MeshComponent && ComponentPool.Num() > 0)
+    {
+        MeshComponent = ComponentPool.Pop(EAllowShrinking::No);
+        MeshComponent = IsValid(MeshComponent) ? MeshComponent : nullptr;
+    }
+
+    if (MeshComponent)
+    {
+        MeshComponent->SetVisibility(true);
+        MeshComponent->SetCollisionEnabled(GetDefault<UStaticMeshComponent>()->GetCollisionEnabled());
+    }
+    else
+    {
+        // Spawn the static mesh component
+        MeshComponent = NewObject<UStaticMeshComponent>(GetOwner());
+        MeshComponent->RegisterComponent();
+    }
+
+    MeshComponent->SetStaticMesh(TileMesh);
+    MeshComponent->SetRelativeTransform(Transform);
+    CellComponents[CellIndex] = MeshComponent;
+}
+
+void UWaveFunctionCollapseComponent::CompactTileInstances()
+{
+    // Parked instances still cost vertex work, so rebuild a tile type once they outnumber the shown ones
+    constexpr int32 MinParkedToCompact = 64;
+
+    for (int32 TileIndex = 0; TileIndex < FreeInstances.Num() && TileIndex < TileInstances.Num(); ++TileIndex)
+    {
+        UInstancedStaticMeshComponent* Instances = TileInstances[TileIndex];
+        TArray<int32>& Free = FreeInstances[TileIndex];
+
+        if (!Instances || Free.Num() < MinParkedToCompact || Free.Num() * 2 < Instances->GetInstanceCount())
+            continue;
+
+        TArray<int32> Cells;
+        TArray<FTransform> Transforms;
+        for (int32 i = 0; i < SpawnedStates.Num(); ++i)
+        {
+            if (SpawnedStates[i] >= 0 && GetSourceTile(SpawnedStates[i]) == TileIndex)
+            {
+                Cells.Add(i);
+                Transforms.Add(GetTileTransform(i, SpawnedOrigin, SpawnedStates[i]));
+            }
+        }
+
+        Instances->ClearInstances();
+        Free.Reset();
+
+        const TArray<int32> Indices = Instances->AddInstances(Transforms, true);
+        for (int32 i = 0; i < Cells.Num(); ++i)
+        {
+            SpawnedInstances[Cells[i]] = Indices[i];
+        }
+    }
+}
+
+UInstancedStaticMeshComponent* UWaveFunctionCollapseComponent::GetTileInstances(int32 TileIndex)
+{
+    if (TileInstances.Num() <= TileIndex)
+    {
+        TileInstances.SetNum(TileIndex + 1);
+    }
+
+    const bool bHierarchical = OutputMode == EWFCOutputMode::HierarchicalInstancedStaticMesh;
+    UClass* InstancesClass = bHierarchical ? UHierarchicalInstancedStaticMeshComponent::StaticClass() : UInstancedStaticMeshComponent::StaticClass();
+
+    TObjectPtr<UInstancedStaticMeshComponent>& Instances = TileInstances[TileIndex];
+
+    // Replace the component if the output mode changed since it was created
+    if (Instances && Instances->GetClass() != InstancesClass)
+    {
+        Instances->DestroyComponent();
+        Instances = nullptr;
+    }
+
+    if (!Instances)
+    {
+        Instances = NewObject<UInstancedStaticMeshComponent>(GetOwner(), InstancesClass);
+        Instances->RegisterComponent();
+    }
+
+    // Tile types may have been edited between generations
+    UStaticMesh* TileMesh = TileTypes[TileIndex].Mesh;
+    if (Instances->GetStaticMesh() != TileMesh)
+    {
+        Instances->SetStaticMesh(TileMesh);
+    }
+
+    return Instances;
+}
+
+void UWaveFunctionCollapseComponent::ClearTileInstances()
+{
+    for (UInstancedStaticMeshComponent* Instances : TileInstances)
+    {
+        if (Instances)
+        {
+            Instances->ClearInstances();
+        }
+    }
+}
@@ -4,77 +4,20 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "WFCTypes.h"
+#include "WFCRules.h"
+#include "WFCSolver.h"
+#include "WFCParallelSolver.h"
+#include "WFCGridFile.h"
 #include "WaveFunctionCollapseComponent.generated.h"
 
-// Enum to represent connection types on tile edges
-UENUM(BlueprintType)
-enum class ETileEdgeType : uint8
-{
-    Type_A UMETA(DisplayName = "Type A"),
-    Type_B UMETA(DisplayName = "Type B"),
-    Type_C UMETA(DisplayName = "Type C"),
-    Type_D UMETA(DisplayName = "Type D")
-    // Add more types as needed
-};
-
-// Structure to represent a tile type with its edge types
-USTRUCT(BlueprintType)
-struct WFC_API FTileType
-{
-    GENERATED_USTRUCT_BODY()
-
-    // The mesh to use for this tile
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Tile Properties")
-    UStaticMesh* Mesh;
-
-    // Edge types for each direction (North, East, South, West)
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Edge Types")
-    ETileEdgeType NorthEdge;
-
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Edge Types")
-    ETileEdgeType EastEdge;
+class UStaticMeshComponent;
+class UTexture2D;
+struct FWFCSample;
+class UInstancedStaticMeshComponent;
 
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Edge Types")
-    ETileEdgeType SouthEdge;
-
-    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Edge Types")
-    ETileEdgeType WestEdge;
-
-    FTileType()
-    {
-        Mesh = nullptr;
-        NorthEdge = ETileEdgeType::Type_A;
-        EastEdge = ETileEdgeType::Type_A;
-        SouthEdge = ETileEdgeType::Type_A;
-        WestEdge = ETileEdgeType::Type_A;
-    }
-};
-
-// Represents a cell in the grid that can be collapsed to a specific tile type
-USTRUCT(BlueprintType)
-struct WFC_API FCell 
-{
-    GENERATED_USTRUCT_BODY()
-
-    // Possible states (tile types) this cell can have
-    UPROPERTY(VisibleAnywhere, Category="Cell Properties")
-    TArray<int32> PossibleStates;
-
-    // Is this cell collapsed to a single state?
-    UPROPERTY(VisibleAnywhere, Category="Cell Properties")
-    bool bIsCollapsed;
-
-    // The final state after collapse (tile type index)
-    UPROPERTY(VisibleAnywhere, Category="Cell Properties")
-    int32 FinalState;
-
-    // Constructor with default values
-    FCell() 
-    {
-        bIsCollapsed = false;
-        FinalState = -1;
-    }
-};
+// Broadcast when a generation has finished and its tiles have been spawned
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FWFCGenerationCompleteSignature, bool, bSuccess);
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class WFC_API UWaveFunctionCollapseComponent : public UActorComponent
@@ -89,6 +32,12 @@ protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
 
+	// Called when the component is removed from play
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Registers ReplicatedGeneration
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
 public:	
 	// Called every frame
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
@@ -97,6 +46,36 @@ public:
     UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse")
     void GenerateGrid();
 
+    // Solves the grid on a worker thread and spawns the tiles on the game thread when done
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse")
+    void GenerateGridAsync();
+
+    // Stops a pending asynchronous generation; its result will be discarded
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse")
+    void CancelGeneration();
+
+    // Remove every spawned tile; its components are kept hidden for the next generation to reuse
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse")
+    void ClearGrid();
+
+    // Re-solve the cells of the last generated grid inside Region (in cells, Max exclusive) on every layer, keeping the cells around it.
+    // Only the tiles that changed are respawned. Returns false and leaves the grid untouched if the region can't be solved,
+    // or if the tile rules have changed since the grid was generated.
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse")
+    bool ResolveRegion(FIntRect Region);
+
+    // Is an asynchronous or time sliced generation still running?
+    UFUNCTION(BlueprintPure, Category = "WaveFunctionCollapse")
+    bool IsGenerating() const;
+
+    // Percentage of cells collapsed by the current time sliced generation
+    UFUNCTION(BlueprintPure, Category = "WaveFunctionCollapse")
+    float GetGenerationProgress() const;
+
+    // Fired once a generation has finished and its tiles are spawned
+    UPROPERTY(BlueprintAssignable, Category = "WaveFunctionCollapse")
+    FWFCGenerationCompleteSignature OnGenerationComplete;
+
     // Define the grid dimensions
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse")
     int32 GridWidth = 10;
@@ -104,53 +83,420 @@ public:
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse")
     int32 GridHeight = 10;
 
+    // Number of layers stacked on top of each other; tiles on adjacent layers are matched by their up and down edges
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse", meta = (ClampMin = "1"))
+    int32 GridDepth = 1;
+
     // The tile types available
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse")
     TArray<FTileType> TileTypes;
 
+    // Learn the rules from tile edges, or from the patterns of a sample
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse")
+    EWFCModel Model = EWFCModel::Tiled;
+
+    // Sample of the overlapping model. It needs uncompressed pixels, so use the UserInterface2D
+    // compression setting without mipmaps. Pixels are matched to the closest color in SamplePalette.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Overlapping", meta = (EditCondition = "Model == EWFCModel::Overlapping"))
+    TObjectPtr<UTexture2D> SampleTexture;
+
+    // Color standing for each tile type in SampleTexture, in TileTypes order
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Overlapping", meta = (EditCondition = "Model == EWFCModel::Overlapping"))
+    TArray<FColor> SamplePalette;
+
+    // Tile type indices of an authored sample, row by row, used when there is no SampleTexture
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Overlapping", meta = (EditCondition = "Model == EWFCModel::Overlapping"))
+    TArray<int32> SampleGrid;
+
+    // Number of cells in each row of SampleGrid
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Overlapping", meta = (EditCondition = "Model == EWFCModel::Overlapping", ClampMin = "1"))
+    int32 SampleGridWidth = 8;
+
+    // Side length of the patterns taken from the sample; larger patterns copy more of it
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Overlapping", meta = (EditCondition = "Model == EWFCModel::Overlapping", ClampMin = "2", ClampMax = "8"))
+    int32 PatternSize = 3;
+
+    // Take patterns that wrap around the sample edges, for samples that tile
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Overlapping", meta = (EditCondition = "Model == EWFCModel::Overlapping"))
+    bool bPeriodicSample = true;
+
     // Edge compatibility rules - defines which edge types can connect
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse")
     TMap<ETileEdgeType, ETileEdgeType> CompatibleEdges;
 
+    // Edges that connect to several edge types, added to the pairs in CompatibleEdges.
+    // Like those pairs, every rule has to be listed from both sides.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse")
+    TArray<FEdgeCompatibility> EdgeCompatibility;
+
+    // Tiles allowed or banned in boxes of cells before solving, e.g. to pin roads and landmarks in place
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Constraints")
+    TArray<FWFCCellConstraint> CellConstraints;
+
+    // Edge types outside the sides of the grid that the tiles along them have to fit; several entries for one side allow any of them
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Constraints")
+    TArray<FWFCBoundaryEdge> BoundaryEdges;
+
+    // Add constraints applied from the next generation on
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse|Constraints")
+    void AddCellConstraints(const TArray<FWFCCellConstraint>& Constraints);
+
+    // Remove every cell constraint and boundary edge
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse|Constraints")
+    void ClearConstraints();
+
     // Spacing between cells
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse")
     float TileSize = 100.f;
 
+    // Vertical spacing between layers
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse", meta = (EditCondition = "GridDepth > 1"))
+    float LayerHeight = 100.f;
+
+    // Constraint propagation algorithm; support counts scale better with large tile sets
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse")
+    EWFCPropagator Propagator = EWFCPropagator::Bitmask;
+
+    // How tiles are spawned; instanced modes use one component per tile type and are reused across generations
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse")
+    EWFCOutputMode OutputMode = EWFCOutputMode::StaticMeshComponents;
+
+    // Seed of the generation; the same seed, rules and grid size always give the same grid
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse")
+    int32 Seed = 0;
+
+    // Pick a new seed for every generation and store it in Seed, so the result can still be reproduced
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse")
+    bool bRandomizeSeed = false;
+
+    // Solve large grids as independent regions on several worker threads, then fill the seams between them
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Parallel")
+    bool bSolveRegionsInParallel = false;
+
+    // Side length in cells of each region solved in parallel
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Parallel", meta = (EditCondition = "bSolveRegionsInParallel", ClampMin = "4"))
+    int32 ParallelRegionSize = 64;
+
+    // Spread GenerateGrid over several frames instead of solving it in one go; regions are not solved in parallel then
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Time Slicing")
+    bool bTimeSliced = false;
+
+    // Time spent solving per frame when time sliced
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Time Slicing", meta = (EditCondition = "bTimeSliced", ClampMin = "1", Units = "Microseconds"))
+    float TimeSliceBudgetMicroseconds = 2000.f;
+
+    // Spawn tiles as soon as their cells collapse instead of when the whole grid is done
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Time Slicing", meta = (EditCondition = "bTimeSliced"))
+    bool bSpawnIncrementally = false;
+
+    // Reuse the grid solved earlier for the same tile set, edge rules, grid size, seed and solver settings.
+    // Grids of randomized seeds are not stored.
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Cache")
+    bool bCacheResults = false;
+
+    // Also keep cached grids in Saved/WFCCache so they survive restarts
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Cache", meta = (EditCondition = "bCacheResults"))
+    bool bCacheOnDisk = true;
+
+    // Forget every cached grid, in memory and on disk
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse|Cache")
+    static void ClearResultCache();
+
+    // Save the last generated grid to a compact binary file
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse|Serialization")
+    bool ExportGrid(const FString& FilePath, bool bCompress = true);
+
+    // Load a grid saved by ExportGrid and spawn it without solving. The file must have been
+    // written with the same tile set and edge rules; the grid size and seed are taken from it.
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse|Serialization")
+    bool ImportGrid(const FString& FilePath);
+
+    // Like ImportGrid, but reads the file on a worker thread and fires OnGenerationComplete when done
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse|Serialization")
+    void ImportGridAsync(const FString& FilePath);
+
+    // Most recent observations that can be undone when a cell runs out of states; 0 disables backtracking
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Backtracking", meta = (ClampMin = "0"))
+    int32 BacktrackDepth = 64;
+
+    // Total observations that may be undone in one generation
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Backtracking", meta = (ClampMin = "0"))
+    int32 MaxBacktracks = 1000;
+
+    // Half size of the cube of cells regenerated around a contradiction backtracking can't fix; 0 disables it
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Backtracking", meta = (ClampMin = "0"))
+    int32 LocalRestartRadius = 4;
+
+    // Local restarts allowed before the generation fails; each one grows the region
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse|Backtracking", meta = (ClampMin = "0"))
+    int32 MaxLocalRestarts = 16;
+
     // Validate that the edge compatibility rules are properly set up
     UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse")
     bool ValidateEdgeRules();
+
+    // Can an edge of type Edge be placed against an edge of type Other, by CompatibleEdges and EdgeCompatibility?
+    UFUNCTION(BlueprintPure, Category = "WaveFunctionCollapse")
+    bool AreEdgesCompatible(ETileEdgeType Edge, ETileEdgeType Other) const;
+
+    // Check that the last generated grid is complete and every pair of adjacent tiles has compatible edges
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse|Verification")
+    bool VerifyGrid();
+
+    // Solve the current settings twice without spawning and check both solves give the same grid
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse|Verification")
+    bool VerifyDeterminism();
+
+    // Get a snapshot of a grid cell for inspection; Z is the layer
+    UFUNCTION(BlueprintPure, Category = "WaveFunctionCollapse")
+    FCell GetCell(int32 X, int32 Y, int32 Z = 0) const;
+
+    // Generate the grid when play begins; disable when another system drives generation
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "WaveFunctionCollapse")
+    bool bGenerateOnBeginPlay = true;
+
+    // Generate on the server only and replicate the seed, grid size, solver settings, rule and constraint hashes and
+    // re-solved regions instead of any tile. Clients run the same solver, or load their cached result when their rules
+    // differ, and check the grid against the server's checksum. The owning actor has to replicate, and only the server
+    // should call ResolveRegion.
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "WaveFunctionCollapse|Networking")
+    bool bReplicateGeneration = false;
+
+    // CRC32 of the tile index of every cell of the last generated grid
+    UFUNCTION(BlueprintPure, Category = "WaveFunctionCollapse|Networking")
+    int32 GetGridChecksum() const;
+
+    // Does the grid of this client match the server's? Always true on the server and without replication.
+    UFUNCTION(BlueprintPure, Category = "WaveFunctionCollapse|Networking")
+    bool IsGridInSync() const { return bGridInSync; }
+
+    // Validate the rules and compile them into a fresh adjacency table, along with the initial constraints
+    bool CompileRules();
+
+    // Adjacency table of the last successful CompileRules, may be null
+    TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> GetCompiledRules() const { return CompiledRules; }
+
+    // State of an asynchronous solve shared between the game thread and its worker
+    struct FAsyncGeneration
+    {
+        std::atomic<bool> bCancelled { false };
+
+        // Rules the generation is solved with, which its tile indices refer to
+        TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> Rules;
+    };
+
+    typedef TSharedPtr<FAsyncGeneration, ESPMode::ThreadSafe> FGenerationHandle;
+
+    // Start a generation that is solved off the game thread, by GenerateGridAsync or UWFCSubsystem::GenerateBatch.
+    // Compiles the rules, picks the seed and fills OutSettings and OutRegionSize for a RunSolve with GetCompiledRules.
+    // Returns null if there is nothing to solve: the rules are invalid, or a cached grid was spawned right away,
+    // in which case bOutCompleted is set.
+    FGenerationHandle BeginAsyncGeneration(FWFCSolverSettings& OutSettings, int32& OutRegionSize, bool& bOutCompleted);
+
+    // Run a complete solve into TargetSolver, split into parallel regions when RegionSize is set.
+    // Every generation solves through here, so a grid only depends on its settings and not on how it was started.
+    static EWFCSolveStatus RunSolve(FWFCSolver& TargetSolver, FWFCSolver::FRulesRef Rules, const FWFCSolverSettings& Settings, int32 RegionSize, const std::atomic<bool>* bCancelled = nullptr);
+
+    // Spawn the grid solved for a generation from BeginAsyncGeneration and notify listeners.
+    // Grids the CPU solver can't solve again from the settings, like GPU bakes, are passed with bReproducible unset;
+    // they are neither stored in the result cache nor replicated.
+    // Returns false and drops the grid if the generation was cancelled or replaced since.
+    bool FinishAsyncGeneration(const FGenerationHandle& Generation, EWFCSolveStatus Status, int32 MaxIterations, TArray<int32>&& States, bool bReproducible = true);
 	
 private:
-    // The grid of cells
-    TArray<FCell> Grid;
+    // Solver of the last synchronous generation, kept so regenerating reuses its buffers
+    FWFCSolver Solver;
+
+    // Cells collapsed during the last time slice, kept so incremental spawning doesn't allocate every tick
+    TArray<int32> CollapsedCells;
+
+    // Adjacency table compiled from TileTypes and CompatibleEdges at the start of each generation.
+    // A new table is built every time, so running solves keep reading their own snapshot.
+    TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> CompiledRules;
+
+    // CellConstraints and BoundaryEdges as tile masks for CompiledRules, null when there are none
+    TSharedPtr<const FWFCInitialConstraints, ESPMode::ThreadSafe> InitialConstraints;
+
+    // Tile index of every cell from the last finished generation, -1 where nothing was placed
+    TArray<int32> FinalStates;
+
+    // Rules FinalStates was solved with. Its tile indices only mean something with these,
+    // even after CompileRules has replaced CompiledRules.
+    TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> FinalRules;
+
+    // The asynchronous generation in flight, if any
+    TSharedPtr<FAsyncGeneration, ESPMode::ThreadSafe> PendingGeneration;
+
+    // Instanced mesh components of the instanced output modes, indexed by tile type
+    UPROPERTY(Transient)
+    TArray<TObjectPtr<UInstancedStaticMeshComponent>> TileInstances;
+
+    // Static mesh component showing each cell in StaticMeshComponents mode, null where nothing is shown
+    UPROPERTY(Transient)
+    TArray<TObjectPtr<UStaticMeshComponent>> CellComponents;
+
+    // Hidden static mesh components released by earlier generations, ready to be reused
+    UPROPERTY(Transient)
+    TArray<TObjectPtr<UStaticMeshComponent>> ComponentPool;
+
+    // Compiled tile index shown at each cell, -1 where nothing is shown.
+    // New generations are diffed against this so only changed cells are touched.
+    TArray<int32> SpawnedStates;
+
+    // Instance index of each shown cell in the instanced component of its tile type
+    TArray<int32> SpawnedInstances;
+
+    // Instances parked at zero scale per tile type, reused before new ones are added.
+    // Instanced components and this pool are per tile type, not per variant.
+    TArray<TArray<int32>> FreeInstances;
+
+    // Layout the shown tiles were placed with; changing any of it respawns everything
+    FVector SpawnedOrigin = FVector::ZeroVector;
+    float SpawnedTileSize = 0.f;
+    float SpawnedLayerHeight = 0.f;
+    int32 SpawnedWidth = 0;
+    int32 SpawnedHeight = 0;
+    EWFCOutputMode SpawnedOutputMode = EWFCOutputMode::StaticMeshComponents;
+    uint64 SpawnedRuleHash = 0;
+
+    // Is the solver being advanced from TickComponent?
+    bool bTimeSlicing = false;
+
+    // Cache key and parallel region size of the last generation, taken when it started
+    uint64 GenerationCacheKey = 0;
+    int32 GenerationRegionSize = 0;
 
-    // Find the cell with the lowest entropy (fewest possible states)
-    int32 FindCellWithLowestEntropy();
+    // Regions re-solved since the last generation; salts their seeds so re-solving an area gives new tiles
+    int32 NumRegionResolves = 0;
 
-    // Collapse a single cell to a definite state
-    void CollapseCell(int32 CellIndex);
+    // Description of the server's grid that clients rebuild it from
+    UPROPERTY(ReplicatedUsing = OnRep_ReplicatedGeneration)
+    FWFCReplicatedGeneration ReplicatedGeneration;
 
-    // Propagate constraints after a cell has been collapsed
-    void PropagateConstraints(int32 CellIndex);
+    // Generations described on the server so far, including ones clients can't rebuild
+    int32 NumReplicatedGenerations = 0;
 
-    // Update possible states of a neighboring cell
-    bool UpdateCellPossibilities(int32 CellIndex, const TArray<int32>& AllowedStates);
+    // Generation and number of its resolves this client has rebuilt so far
+    int32 AppliedGenerationId = 0;
+    int32 NumAppliedResolves = 0;
 
-    // Check if edge types are compatible
-    bool AreEdgesCompatible(ETileEdgeType Edge1, ETileEdgeType Edge2);
+    // Did the last verified grid match the server's checksum?
+    bool bGridInSync = true;
+
+    UFUNCTION()
+    void OnRep_ReplicatedGeneration();
+
+    // Does this machine generate for the others, or rebuild from ReplicatedGeneration?
+    bool IsReplicatedClient() const;
+
+    // After a grid is generated: describe it on the server, or catch up with the server's resolves on clients.
+    // A grid that isn't reproducible clears the description, so clients keep their last grid.
+    void SyncReplicatedGeneration(bool bReproducible = true);
+
+    // Record a successful region re-solve for clients to replay
+    void RecordReplicatedResolve(const FIntRect& Region, int32 ResolveIndex);
+
+    // Start rebuilding a new generation of the server, or replay the resolves that arrived since the last call
+    void ApplyReplicatedGeneration();
+
+    // Spawn the server's grid from the result cache, if it is there for the compiled rules
+    bool SpawnReplicatedCachedResult();
+
+    // Run solver steps until the frame budget is used up
+    void TickTimeSlice();
+
+    // Draw the seed of a new generation when it is randomized, and restart the region seeds
+    void PickSeed();
+
+    // Hash of everything that determines the grid solved with RegionSize; needs compiled rules
+    uint64 GetCacheKey(int32 RegionSize) const;
+
+    // Describe the last generated grid for saving
+    FWFCGridData MakeGridData() const;
+
+    // Replace the grid with a loaded one and spawn it; fails if it was made with other rules
+    bool ApplyGridData(FWFCGridData&& Grid);
+
+    // Take the key of a new generation solved with RegionSize and, on a cache hit, spawn the cached grid right away.
+    // The key is taken even without caching, for replication. Returns true if the generation is already complete.
+    bool SpawnCachedResult(int32 RegionSize);
+
+    // Settings for a solve of the current grid
+    FWFCSolverSettings MakeSolverSettings() const;
+
+    // Region size to solve in parallel with, or 0 to solve in one piece
+    int32 GetParallelRegionSize() const;
+
+    // Bring the spawned tiles up to date with a finished solve, then notify listeners.
+    // Only reproducible grids are cached and replicated.
+    void FinishGeneration(EWFCSolveStatus Status, int32 MaxIterations, bool bReproducible = true);
+
+    // Compile CompatibleEdges and EdgeCompatibility into one edge compatibility matrix
+    FWFCEdgeMatrix MakeEdgeMatrix() const;
+
+    // Validate the rules and build an adjacency table for the current settings, without replacing CompiledRules; null if they are invalid
+    TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> BuildRules();
+
+    // Build the rules of the overlapping model from the patterns of the sample
+    TSharedPtr<const FWFCCompiledRules, ESPMode::ThreadSafe> BuildOverlappingRules();
+
+    // Turn CellConstraints and BoundaryEdges into tile masks for the compiled rules; false if they leave a cell without tiles
+    bool CompileConstraints();
+
+    // Read the tile type of every cell of the sample texture or authored grid
+    bool ReadSample(FWFCSample& OutSample) const;
 
     // Get all tile indices that have a specific edge type in a specific direction
     TArray<int32> GetTilesWithEdgeType(ETileEdgeType EdgeType, const FString& Direction);
 
-    // Check if all cells have been collapsed
-    bool IsGridFullyCollapsed();
+    // Number of cells on every layer of the grid
+    int32 GetNumCells() const { return GridWidth * GridHeight * GridDepth; }
 
-    // Convert a grid index to a 2D position
-    void IndexToXY(int32 Index, int32& OutX, int32& OutY);
+    // Convert a grid index to a 3D position
+    void IndexToXYZ(int32 Index, int32& OutX, int32& OutY, int32& OutZ) const;
 
-    // Convert a 2D position to a grid index
-    int32 XYToIndex(int32 X, int32 Y);
+    // Convert a 3D position to a grid index
+    int32 XYZToIndex(int32 X, int32 Y, int32 Z) const;
 
-    // Spawn the actual tile meshes
+    // Update the spawned tile meshes to match FinalStates, touching only the cells that changed
     void SpawnTileMeshes();
+
+    // Update the spawned mesh of a single cell
+    void SpawnTile(int32 CellIndex, const FVector& Origin);
+
+    // Tile index a cell should show, or -1 if it has no tile or the tile has no mesh
+    int32 GetShownState(int32 CellIndex) const;
+
+    // Tile type a compiled tile is a variant of; needs compiled rules
+    int32 GetSourceTile(int32 State) const;
+
+    // Location of a cell's tile
+    FVector GetTileLocation(int32 CellIndex, const FVector& Origin) const;
+
+    // Location and orientation of a compiled tile placed at a cell
+    FTransform GetTileTransform(int32 CellIndex, const FVector& Origin, int32 State) const;
+
+    // Size the spawn tracking for FinalStates, releasing everything if the layout changed.
+    // Returns false if it did.
+    bool PrepareSpawnedTiles(const FVector& Origin);
+
+    // Release every shown tile
+    void ReleaseAllTiles();
+
+    // Hide the tile shown at a cell and return its component or instance to the pool.
+    // Instance updates only mark the render state dirty when bMarkDirty is set.
+    void ReleaseTile(int32 CellIndex, bool bMarkDirty);
+
+    // Show the tile of a cell using a pooled component or instance.
+    // New instances are left to the caller in DeferredCells when it is given, so they can be added in batches.
+    void AcquireTile(int32 CellIndex, const FVector& Origin, TArray<TArray<int32>>* DeferredCells);
+
+    // Rebuild the instanced components that are mostly parked instances
+    void CompactTileInstances();
+
+    // Get the instanced component for a tile type, creating it if needed
+    UInstancedStaticMeshComponent* GetTileInstances(int32 TileIndex);
+
+    // Remove all instances while keeping the components for the next generation
+    void ClearTileInstances();
 };
\ No newline at end of file
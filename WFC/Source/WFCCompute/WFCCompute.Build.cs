@@ -0,0 +1,15 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+using UnrealBuildTool;
+
+public class WFCCompute : ModuleRules
+{
+	public WFCCompute(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "WFC" });
+
+		PrivateDependencyModuleNames.AddRange(new string[] { "RenderCore", "RHI" });
+	}
+}
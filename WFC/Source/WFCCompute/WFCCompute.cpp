@@ -0,0 +1,14 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCCompute.h"
+#include "Modules/ModuleManager.h"
+#include "Misc/Paths.h"
+#include "ShaderCore.h"
+
+void FWFCComputeModule::StartupModule()
+{
+    AddShaderSourceDirectoryMapping(TEXT("/WFC"), FPaths::Combine(FPaths::ProjectDir(), TEXT("Shaders")));
+}
+
+IMPLEMENT_MODULE(FWFCComputeModule, WFCCompute);
@@ -0,0 +1,14 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Modules/ModuleInterface.h"
+
+// Experimental GPU backend for offline bakes. Loaded before shaders are compiled
+// so that /WFC maps to the project's Shaders directory.
+class FWFCComputeModule : public IModuleInterface
+{
+public:
+    virtual void StartupModule() override;
+};
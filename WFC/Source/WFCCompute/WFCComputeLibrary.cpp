@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCComputeLibrary.h"
+#include "WFCComputeSolver.h"
+#include "WaveFunctionCollapseComponent.h"
+
+bool UWFCComputeLibrary::GenerateGridOnGPU(UWaveFunctionCollapseComponent* Component, int32 SweepsPerRound, int32 CollapseSpacing)
+{
+    if (!Component)
+        return false;
+
+    // The GPU solves the whole grid at once, so the parallel region size doesn't apply
+    FWFCSolverSettings Settings;
+    int32 RegionSize = 0;
+    bool bCompleted = false;
+    UWaveFunctionCollapseComponent::FGenerationHandle Generation = Component->BeginAsyncGeneration(Settings, RegionSize, bCompleted);
+    if (!Generation)
+        return bCompleted;
+
+    FWFCComputeSolver Solver;
+    Solver.SweepsPerRound = SweepsPerRound;
+    Solver.CollapseSpacing = CollapseSpacing;
+
+    TArray<int32> States;
+    const EWFCSolveStatus Status = Solver.Solve(Component->GetCompiledRules().ToSharedRef(), Settings, States);
+
+    // Rounds stand in for observations in the iteration report.
+    // The CPU solver gives another grid for the same settings, so the bake is neither cached nor replicated.
+    const int32 MaxIterations = Settings.MaxIterations > 0 ? Settings.MaxIterations : States.Num() * 10;
+    return Component->FinishAsyncGeneration(Generation, Status, MaxIterations, MoveTemp(States), false) && Status == EWFCSolveStatus::Completed;
+}
@@ -0,0 +1,23 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "WFCComputeLibrary.generated.h"
+
+class UWaveFunctionCollapseComponent;
+
+// Editor entry points of the experimental GPU solver, for editor utilities and Python bake scripts
+UCLASS()
+class WFCCOMPUTE_API UWFCComputeLibrary : public UBlueprintFunctionLibrary
+{
+	GENERATED_BODY()
+
+public:
+    // Generate the component's grid with FWFCComputeSolver instead of the CPU solver, blocking until it is done.
+    // The component spawns its tiles and broadcasts OnGenerationComplete as usual; save the bake with ExportGrid.
+    // Bakes aren't stored in the result cache or replicated, but a grid already cached for the CPU solver is spawned instead.
+    UFUNCTION(BlueprintCallable, Category = "WaveFunctionCollapse|GPU")
+    static bool GenerateGridOnGPU(UWaveFunctionCollapseComponent* Component, int32 SweepsPerRound = 8, int32 CollapseSpacing = 2);
+};
@@ -0,0 +1,379 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WFCComputeSolver.h"
+#include "GlobalShader.h"
+#include "ShaderParameterStruct.h"
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+#include "RenderingThread.h"
+#include "RHIGPUReadback.h"
+#include "DataDrivenShaderPlatformInfo.h"
+#include "Misc/App.h"
+
+namespace
+{
+    constexpr int32 ThreadGroupSize = 64;
+
+    // Layout of the status buffer, as in WFCCompute.usf
+    enum EStatusSlot
+    {
+        Status_Changed,
+        Status_Uncollapsed,
+        Status_Contradictions,
+        Status_InvMinKey,
+        Status_Count
+    };
+
+    // Structured buffer filled from Data, or zeroed without it, kept alive between graphs
+    TRefCountPtr<FRDGPooledBuffer> CreatePooledBuffer(FRHICommandListImmediate& RHICmdList, const TCHAR* Name, uint32 BytesPerElement, uint32 NumElements, const void* Data)
+    {
+        FRDGBuilder GraphBuilder(RHICmdList);
+        FRDGBufferRef Buffer = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateStructuredDesc(BytesPerElement, NumElements), Name);
+        if (Data)
+        {
+            GraphBuilder.QueueBufferUpload(Buffer, Data, BytesPerElement * NumElements);
+        }
+        else
+        {
+            AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(Buffer), 0u);
+        }
+
+        TRefCountPtr<FRDGPooledBuffer> Pooled = GraphBuilder.ConvertToExternalBuffer(Buffer);
+        GraphBuilder.Execute();
+        return Pooled;
+    }
+}
+
+// Parameters shared by every pass; each shader only binds the ones it uses
+BEGIN_SHADER_PARAMETER_STRUCT(FWFCComputeGridParameters, )
+    SHADER_PARAMETER(FIntVector, GridSize)
+    SHADER_PARAMETER(uint32, NumCells)
+    SHADER_PARAMETER(uint32, NumTiles)
+    SHADER_PARAMETER(uint32, NumWords)
+    SHADER_PARAMETER(uint32, Seed)
+    SHADER_PARAMETER(uint32, Round)
+END_SHADER_PARAMETER_STRUCT()
+
+class FWFCComputeShader : public FGlobalShader
+{
+public:
+    FWFCComputeShader() = default;
+    FWFCComputeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer) {}
+
+    static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+    {
+        return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+    }
+
+    static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+    {
+        FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+        OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE"), ThreadGroupSize);
+    }
+};
+
+class FWFCPropagateCS : public FWFCComputeShader
+{
+    DECLARE_GLOBAL_SHADER(FWFCPropagateCS);
+    SHADER_USE_PARAMETER_STRUCT(FWFCPropagateCS, FWFCComputeShader);
+
+    BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+        SHADER_PARAMETER_STRUCT_INCLUDE(FWFCComputeGridParameters, Grid)
+        SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<uint>, Rules)
+        SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<uint>, WaveIn)
+        SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint>, WaveOut)
+        SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint>, Status)
+    END_SHADER_PARAMETER_STRUCT()
+};
+
+class FWFCReduceCS : public FWFCComputeShader
+{
+    DECLARE_GLOBAL_SHADER(FWFCReduceCS);
+    SHADER_USE_PARAMETER_STRUCT(FWFCReduceCS, FWFCComputeShader);
+
+    BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+        SHADER_PARAMETER_STRUCT_INCLUDE(FWFCComputeGridParameters, Grid)
+        SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<float2>, Weights)
+        SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<uint>, WaveIn)
+        SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<float>, KeysOut)
+        SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint>, Status)
+    END_SHADER_PARAMETER_STRUCT()
+};
+
+class FWFCCollapseCS : public FWFCComputeShader
+{
+    DECLARE_GLOBAL_SHADER(FWFCCollapseCS);
+    SHADER_USE_PARAMETER_STRUCT(FWFCCollapseCS, FWFCComputeShader);
+
+    BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+        SHADER_PARAMETER_STRUCT_INCLUDE(FWFCComputeGridParameters, Grid)
+        SHADER_PARAMETER(float, EntropyBand)
+        SHADER_PARAMETER(int32, CollapseSpacing)
+        SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<float2>, Weights)
+        SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<uint>, WaveIn)
+        SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<uint>, WaveOut)
+        SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<float>, KeysIn)
+        SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<uint>, StatusIn)
+    END_SHADER_PARAMETER_STRUCT()
+};
+
+class FWFCResolveCS : public FWFCComputeShader
+{
+    DECLARE_GLOBAL_SHADER(FWFCResolveCS);
+    SHADER_USE_PARAMETER_STRUCT(FWFCResolveCS, FWFCComputeShader);
+
+    BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+        SHADER_PARAMETER_STRUCT_INCLUDE(FWFCComputeGridParameters, Grid)
+        SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<uint>, WaveIn)
+        SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<int>, States)
+    END_SHADER_PARAMETER_STRUCT()
+};
+
+IMPLEMENT_GLOBAL_SHADER(FWFCPropagateCS, "/WFC/Private/WFCCompute.usf", "PropagateCS", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FWFCReduceCS, "/WFC/Private/WFCCompute.usf", "ReduceCS", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FWFCCollapseCS, "/WFC/Private/WFCCompute.usf", "CollapseCS", SF_Compute);
+IMPLEMENT_GLOBAL_SHADER(FWFCResolveCS, "/WFC/Private/WFCCompute.usf", "ResolveCS", SF_Compute);
+
+bool FWFCComputeSolver::IsSupported(const FWFCCompiledRules& Rules)
+{
+    return FApp::CanEverRender() && GMaxRHIFeatureLevel >= ERHIFeatureLevel::SM5 && Rules.GetNumTiles() > 0 && Rules.GetNumTiles() <= MaxTiles;
+}
+
+EWFCSolveStatus FWFCComputeSolver::Solve(FWFCSolver::FRulesRef Rules, const FWFCSolverSettings& Settings, TArray<int32>& OutStates) const
+{
+    check(IsInGameThread());
+
+    if (!IsSupported(*Rules))
+    {
+        UE_LOG(LogTemp, Error, TEXT("Wave Function Collapse GPU solver needs a SM5 renderer and at most %d tiles, the rules have %d"), MaxTiles, Rules->GetNumTiles());
+        return EWFCSolveStatus::Failed;
+    }
+
+    EWFCSolveStatus Status = EWFCSolveStatus::Failed;
+    ENQUEUE_RENDER_COMMAND(WFCComputeSolve)([this, &Rules, &Settings, &OutStates, &Status](FRHICommandListImmediate& RHICmdList)
+    {
+        // Without backtracking, a contradiction starts the grid over with another seed
+        FWFCSolverSettings AttemptSettings = Settings;
+        for (int32 Attempt = 0; Attempt <= FMath::Max(Settings.MaxLocalRestarts, 0); ++Attempt)
+        {
+            AttemptSettings.Seed = Attempt == 0 ? Settings.Seed : FWFCSolver::DeriveSeed(Settings.Seed, Attempt);
+            Status = SolveAttempt(RHICmdList, *Rules, AttemptSettings, OutStates);
+            if (Status != EWFCSolveStatus::Failed)
+                break;
+        }
+    });
+
+    // Offline only, so simply wait for the render thread
+    FlushRenderingCommands();
+    return Status;
+}
+
+EWFCSolveStatus FWFCComputeSolver::SolveAttempt(FRHICommandListImmediate& RHICmdList, const FWFCCompiledRules& Rules, const FWFCSolverSettings& Settings, TArray<int32>& OutStates) const
+{
+    const int32 Depth = FMath::Max(Settings.Depth, 1);
+    const int32 NumCells = Settings.Width * Settings.Height * Depth;
+    const int32 NumTiles = Rules.GetNumTiles();
+    const int32 NumDirections = FWFCCompiledRules::NumDirections;
+
+    // The shaders work on 32-bit words
+    const int32 NumWords = FMath::DivideAndRoundUp(NumTiles, 32);
+    auto GetWord = [](const uint64* Words, int32 Word)
+    {
+        return static_cast<uint32>(Words[Word / 2] >> (32 * (Word % 2)));
+    };
+
+    // Adjacency rows of every tile, then the union of all of them for neighbors in full superposition
+    TArray<uint32> RuleWords;
+    RuleWords.SetNumZeroed((NumTiles + 1) * NumDirections * NumWords);
+    for (int32 Tile = 0; Tile < NumTiles; ++Tile)
+    {
+        for (int32 Dir = 0; Dir < NumDirections; ++Dir)
+        {
+            const uint64* Allowed = Rules.GetAllowedNeighbors(Tile, static_cast<EWFCDirection>(Dir));
+            for (int32 Word = 0; Word < NumWords; ++Word)
+            {
+                RuleWords[(Tile * NumDirections + Dir) * NumWords + Word] = GetWord(Allowed, Word);
+                RuleWords[(NumTiles * NumDirections + Dir) * NumWords + Word] |= GetWord(Allowed, Word);
+            }
+        }
+    }
+
+    TArray<FVector2f> Weights;
+    Weights.SetNumUninitialized(NumTiles);
+    for (int32 Tile = 0; Tile < NumTiles; ++Tile)
+    {
+        Weights[Tile] = FVector2f(Rules.GetWeight(Tile), Rules.GetWeightLogWeight(Tile));
+    }
+
+    // Every cell in full superposition, narrowed by the initial constraints
+    TArray<uint32> FullRow;
+    FullRow.SetNumZeroed(NumWords);
+    for (int32 Tile = 0; Tile < NumTiles; ++Tile)
+    {
+        FullRow[Tile / 32] |= 1u << (Tile % 32);
+    }
+
+    TArray<uint32> WaveWords;
+    WaveWords.SetNumUninitialized(NumCells * NumWords);
+    for (int32 Cell = 0; Cell < NumCells; ++Cell)
+    {
+        FMemory::Memcpy(&WaveWords[Cell * NumWords], FullRow.GetData(), NumWords * sizeof(uint32));
+    }
+
+    if (Settings.Constraints)
+    {
+        Settings.Constraints->ForEach([&](int32 Cell, const uint64* Mask)
+        {
+            for (int32 Word = 0; Word < NumWords; ++Word)
+            {
+                WaveWords[Cell * NumWords + Word] &= GetWord(Mask, Word);
+            }
+        });
+    }
+
+    TRefCountPtr<FRDGPooledBuffer> RulesBuffer = CreatePooledBuffer(RHICmdList, TEXT("WFC.Rules"), sizeof(uint32), RuleWords.Num(), RuleWords.GetData());
+    TRefCountPtr<FRDGPooledBuffer> WeightsBuffer = CreatePooledBuffer(RHICmdList, TEXT("WFC.Weights"), sizeof(FVector2f), Weights.Num(), Weights.GetData());
+    TRefCountPtr<FRDGPooledBuffer> WaveBuffers[2] =
+    {
+        CreatePooledBuffer(RHICmdList, TEXT("WFC.WaveA"), sizeof(uint32), WaveWords.Num(), WaveWords.GetData()),
+        CreatePooledBuffer(RHICmdList, TEXT("WFC.WaveB"), sizeof(uint32), WaveWords.Num(), nullptr)
+    };
+    TRefCountPtr<FRDGPooledBuffer> KeysBuffer = CreatePooledBuffer(RHICmdList, TEXT("WFC.Keys"), sizeof(float), NumCells, nullptr);
+    TRefCountPtr<FRDGPooledBuffer> StatusBuffer = CreatePooledBuffer(RHICmdList, TEXT("WFC.Status"), sizeof(uint32), Status_Count, nullptr);
+
+    FGlobalShaderMap* ShaderMap = GetGlobalShaderMap(GMaxRHIFeatureLevel);
+    TShaderMapRef<FWFCPropagateCS> PropagateShader(ShaderMap);
+    TShaderMapRef<FWFCReduceCS> ReduceShader(ShaderMap);
+    TShaderMapRef<FWFCCollapseCS> CollapseShader(ShaderMap);
+    TShaderMapRef<FWFCResolveCS> ResolveShader(ShaderMap);
+    const FIntVector GroupCount = FComputeShaderUtils::GetGroupCountWrapped(NumCells, ThreadGroupSize);
+
+    FWFCComputeGridParameters Grid;
+    Grid.GridSize = FIntVector(Settings.Width, Settings.Height, Depth);
+    Grid.NumCells = NumCells;
+    Grid.NumTiles = NumTiles;
+    Grid.NumWords = NumWords;
+    Grid.Seed = static_cast<uint32>(Settings.Seed);
+    Grid.Round = 0;
+
+    // Index of the wave buffer holding the current state
+    int32 Current = 0;
+    bool bCollapseNext = false;
+    const int32 MaxRounds = Settings.MaxIterations > 0 ? Settings.MaxIterations : NumCells * 10;
+    EWFCSolveStatus Result = EWFCSolveStatus::Running;
+    FRHIGPUBufferReadback StatusReadback(TEXT("WFC.StatusReadback"));
+
+    while (Result == EWFCSolveStatus::Running)
+    {
+        FRDGBuilder GraphBuilder(RHICmdList);
+        FRDGBufferRef Rules32 = GraphBuilder.RegisterExternalBuffer(RulesBuffer);
+        FRDGBufferRef WeightsRDG = GraphBuilder.RegisterExternalBuffer(WeightsBuffer);
+        FRDGBufferRef Wave[2] = { GraphBuilder.RegisterExternalBuffer(WaveBuffers[0]), GraphBuilder.RegisterExternalBuffer(WaveBuffers[1]) };
+        FRDGBufferRef Keys = GraphBuilder.RegisterExternalBuffer(KeysBuffer);
+        FRDGBufferRef StatusRDG = GraphBuilder.RegisterExternalBuffer(StatusBuffer);
+
+        // Collapse against the keys and lowest entropy reduced at the end of the last graph
+        if (bCollapseNext)
+        {
+            FWFCCollapseCS::FParameters* Parameters = GraphBuilder.AllocParameters<FWFCCollapseCS::FParameters>();
+            Parameters->Grid = Grid;
+            Parameters->EntropyBand = EntropyBand;
+            Parameters->CollapseSpacing = FMath::Max(CollapseSpacing, 1);
+            Parameters->Weights = GraphBuilder.CreateSRV(WeightsRDG);
+            Parameters->WaveIn = GraphBuilder.CreateSRV(Wave[Current]);
+            Parameters->WaveOut = GraphBuilder.CreateUAV(Wave[1 - Current]);
+            Parameters->KeysIn = GraphBuilder.CreateSRV(Keys);
+            Parameters->StatusIn = GraphBuilder.CreateSRV(StatusRDG);
+            FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("WFC.Collapse"), CollapseShader, Parameters, GroupCount);
+
+            Current = 1 - Current;
+            ++Grid.Round;
+        }
+
+        // Only the last sweep decides whether the wave is stable
+        const int32 NumSweeps = FMath::Max(SweepsPerRound, 1);
+        for (int32 Sweep = 0; Sweep < NumSweeps; ++Sweep)
+        {
+            if (Sweep == NumSweeps - 1)
+            {
+                AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(StatusRDG), 0u);
+            }
+
+            FWFCPropagateCS::FParameters* Parameters = GraphBuilder.AllocParameters<FWFCPropagateCS::FParameters>();
+            Parameters->Grid = Grid;
+            Parameters->Rules = GraphBuilder.CreateSRV(Rules32);
+            Parameters->WaveIn = GraphBuilder.CreateSRV(Wave[Current]);
+            Parameters->WaveOut = GraphBuilder.CreateUAV(Wave[1 - Current]);
+            Parameters->Status = GraphBuilder.CreateUAV(StatusRDG);
+            FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("WFC.Propagate"), PropagateShader, Parameters, GroupCount);
+
+            Current = 1 - Current;
+        }
+
+        {
+            FWFCReduceCS::FParameters* Parameters = GraphBuilder.AllocParameters<FWFCReduceCS::FParameters>();
+            Parameters->Grid = Grid;
+            Parameters->Weights = GraphBuilder.CreateSRV(WeightsRDG);
+            Parameters->WaveIn = GraphBuilder.CreateSRV(Wave[Current]);
+            Parameters->KeysOut = GraphBuilder.CreateUAV(Keys);
+            Parameters->Status = GraphBuilder.CreateUAV(StatusRDG);
+            FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("WFC.Reduce"), ReduceShader, Parameters, GroupCount);
+        }
+
+        AddEnqueueCopyPass(GraphBuilder, &StatusReadback, StatusRDG, Status_Count * sizeof(uint32));
+        GraphBuilder.Execute();
+
+        // Offline bakes can afford a full GPU sync per round
+        RHICmdList.BlockUntilGPUIdle();
+
+        uint32 Status[Status_Count];
+        FMemory::Memcpy(Status, StatusReadback.Lock(sizeof(Status)), sizeof(Status));
+        StatusReadback.Unlock();
+
+        if (Status[Status_Contradictions] > 0)
+        {
+            Result = EWFCSolveStatus::Failed;
+        }
+        else if (Status[Status_Changed] != 0)
+        {
+            // Not stable yet, keep sweeping before the next collapse
+            bCollapseNext = false;
+        }
+        else if (Status[Status_Uncollapsed] == 0)
+        {
+            Result = EWFCSolveStatus::Completed;
+        }
+        else if (static_cast<int32>(Grid.Round) >= MaxRounds)
+        {
+            Result = EWFCSolveStatus::Incomplete;
+        }
+        else
+        {
+            bCollapseNext = true;
+        }
+    }
+
+    // Read the tile of every cell back in the solver's output format
+    FRHIGPUBufferReadback StatesReadback(TEXT("WFC.StatesReadback"));
+    {
+        FRDGBuilder GraphBuilder(RHICmdList);
+        FRDGBufferRef States = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(int32), NumCells), TEXT("WFC.States"));
+
+        FWFCResolveCS::FParameters* Parameters = GraphBuilder.AllocParameters<FWFCResolveCS::FParameters>();
+        Parameters->Grid = Grid;
+        Parameters->WaveIn = GraphBuilder.CreateSRV(GraphBuilder.RegisterExternalBuffer(WaveBuffers[Current]));
+        Parameters->States = GraphBuilder.CreateUAV(States);
+        FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("WFC.Resolve"), ResolveShader, Parameters, GroupCount);
+
+        AddEnqueueCopyPass(GraphBuilder, &StatesReadback, States, NumCells * sizeof(int32));
+        GraphBuilder.Execute();
+    }
+
+    RHICmdList.BlockUntilGPUIdle();
+    OutStates.SetNumUninitialized(NumCells);
+    FMemory::Memcpy(OutStates.GetData(), StatesReadback.Lock(NumCells * sizeof(int32)), NumCells * sizeof(int32));
+    StatesReadback.Unlock();
+
+    return Result;
+}
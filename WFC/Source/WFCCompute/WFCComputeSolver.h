@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WFCSolver.h"
+
+class FRHICommandListImmediate;
+
+// Experimental solver running the whole solve in compute shaders, for offline bakes of very large grids.
+// The adjacency table and the wave are uploaded once. Each round then collapses, in one dispatch, every
+// low entropy cell that has the lowest entropy within CollapseSpacing cells, so the cells collapsed
+// together never interact. Jacobi propagation sweeps follow until the wave is stable.
+// The lowest entropy and the cell counts are reduced on the GPU; only a few status words are read back per round.
+// Backtracking is not supported: a contradiction restarts the whole grid with a derived seed, up to
+// Settings.MaxLocalRestarts times. The result uses the same tile indices as FWFCSolver::GetFinalStates,
+// but not the same grid, since observation order differs.
+struct WFCCOMPUTE_API FWFCComputeSolver
+{
+    // Largest tile set the shaders hold in registers
+    static constexpr int32 MaxTiles = 512;
+
+    // Propagation sweeps dispatched between two status reads
+    int32 SweepsPerRound = 8;
+
+    // Cells collapsed in the same round are more than this many cells apart along every axis
+    int32 CollapseSpacing = 2;
+
+    // Cells within this much entropy of the lowest uncollapsed cell can be collapsed in a round
+    float EntropyBand = 0.5f;
+
+    // Can the rules be solved on this machine?
+    static bool IsSupported(const FWFCCompiledRules& Rules);
+
+    // Solve the grid described by Settings and return the tile index of every cell, -1 where none.
+    // Must be called on the game thread, which blocks until the GPU is done.
+    EWFCSolveStatus Solve(FWFCSolver::FRulesRef Rules, const FWFCSolverSettings& Settings, TArray<int32>& OutStates) const;
+
+private:
+    EWFCSolveStatus SolveAttempt(FRHICommandListImmediate& RHICmdList, const FWFCCompiledRules& Rules, const FWFCSolverSettings& Settings, TArray<int32>& OutStates) const;
+};
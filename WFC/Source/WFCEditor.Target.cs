@@ -11,5 +11,6 @@ public class WFCEditorTarget : TargetRules
 		DefaultBuildSettings = BuildSettingsVersion.V5;
 		IncludeOrderVersion = EngineIncludeOrderVersion.Unreal5_5;
 		ExtraModuleNames.Add("WFC");
+		ExtraModuleNames.Add("WFCCompute");
 	}
 }